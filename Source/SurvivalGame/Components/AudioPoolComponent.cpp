@@ -0,0 +1,98 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Components/AudioPoolComponent.h"
+#include "Components/AudioComponent.h"
+#include "Player/SurvivalCharacter.h"
+#include "Weapons/CombatFXSubsystem.h"
+#include "Sound/SoundBase.h"
+
+// Sets default values for this component's properties
+UAudioPoolComponent::UAudioPoolComponent()
+{
+	MaxVoices = 6;
+	NextStealIndex = 0;
+}
+
+UAudioComponent* UAudioPoolComponent::PlaySound(USoundBase* Sound, const FName ConcurrencyGroup /*= NAME_None*/, const float Priority /*= 1.f*/)
+{
+	if (!Sound || !GetOwner() || GetNetMode() == NM_DedicatedServer) {
+		return nullptr;
+	}
+
+	UCombatFXSubsystem* FXSubsystem = GetWorld()->GetSubsystem<UCombatFXSubsystem>();
+	const FVector SoundLocation = GetOwner()->GetActorLocation();
+
+	//ask for a voice before touching the pool, losing sounds shouldn't cut off our other sounds
+	if (FXSubsystem && !ConcurrencyGroup.IsNone() && !FXSubsystem->CanPlayVoice(ConcurrencyGroup, SoundLocation, Priority, Cast<ASurvivalCharacter>(GetOwner()))) {
+		return nullptr;
+	}
+
+	UAudioComponent* AC = AcquireAudioComponent();
+	if (!AC) {
+		return nullptr;
+	}
+
+	AC->SetSound(Sound);
+	AC->Play();
+
+	if (FXSubsystem && !ConcurrencyGroup.IsNone()) {
+		FXSubsystem->AddVoice(ConcurrencyGroup, AC, SoundLocation, Priority, Cast<ASurvivalCharacter>(GetOwner()));
+	}
+
+	return AC;
+}
+
+void UAudioPoolComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	for (UAudioComponent* AC : AudioComponents) {
+		if (AC) {
+			AC->Stop();
+		}
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+UAudioComponent* UAudioPoolComponent::AcquireAudioComponent()
+{
+	UCombatFXSubsystem* FXSubsystem = GetWorld()->GetSubsystem<UCombatFXSubsystem>();
+
+	for (UAudioComponent* AC : AudioComponents) {
+		if (AC && !AC->IsPlaying()) {
+			if (FXSubsystem) {
+				FXSubsystem->NotifyAudioComponentAcquired(false);
+			}
+			return AC;
+		}
+	}
+
+	if (AudioComponents.Num() < MaxVoices) {
+		UAudioComponent* AC = NewObject<UAudioComponent>(GetOwner());
+		AC->bAutoActivate = false;
+		AC->bAutoDestroy = false;
+		AC->SetupAttachment(GetOwner()->GetRootComponent());
+		AC->RegisterComponent();
+		AudioComponents.Add(AC);
+
+		if (FXSubsystem) {
+			FXSubsystem->NotifyAudioComponentAcquired(true);
+		}
+		return AC;
+	}
+
+	//every voice is busy, cut off our sounds in turn
+	if (AudioComponents.Num() > 0) {
+		NextStealIndex = NextStealIndex % AudioComponents.Num();
+		UAudioComponent* AC = AudioComponents[NextStealIndex++];
+		if (AC) {
+			AC->Stop();
+			if (FXSubsystem) {
+				FXSubsystem->NotifyAudioComponentAcquired(false);
+			}
+		}
+		return AC;
+	}
+
+	return nullptr;
+}
@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "AudioPoolComponent.generated.h"
+
+class UAudioComponent;
+class USoundBase;
+
+/**
+ * Keeps a small set of audio components attached to the owner and reuses them for one shot sounds,
+ * instead of spawning a new audio component for every gunshot, reload or equip sound.
+ * Sounds in a concurrency group (ie gunshots) also have to win a voice from the UCombatFXSubsystem.
+ */
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class SURVIVALGAME_API UAudioPoolComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UAudioPoolComponent();
+
+	/**
+	 * Play a sound on a pooled audio component attached to the owner.
+	 * Return null if nothing was played (dedicated server, or the concurrency group had no voice to give us)
+	 */
+	UAudioComponent* PlaySound(USoundBase* Sound, const FName ConcurrencyGroup = NAME_None, const float Priority = 1.f);
+
+protected:
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Max audio components this owner keeps. When all of them are busy one of our playing sounds gets cut off */
+	UPROPERTY(EditDefaultsOnly, Category = "Audio")
+	int32 MaxVoices;
+
+	UPROPERTY(Transient)
+	TArray<UAudioComponent*> AudioComponents;
+
+	/** next component to cut off when every voice is busy */
+	int32 NextStealIndex;
+
+	/** Get an idle audio component, creating or stealing one if needed */
+	UAudioComponent* AcquireAudioComponent();
+};
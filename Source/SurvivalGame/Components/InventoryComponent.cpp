@@ -48,7 +48,7 @@ int32 UInventoryComponent::ConsumeItem(class UItem* Item, const int32 Quantity)
 		if (Item->GetQuantity() <= 0) {
 			RemoveItem(Item);
 		}
-		else {
+		else if (GetIsReplicated()) {
 			ClientRefreshInventory();
 		}
 
@@ -68,6 +68,32 @@ bool UInventoryComponent::RemoveItem(class UItem* Item)
 	return false;
 }
 
+UItem* UInventoryComponent::AddItemUnchecked(TSubclassOf<class UItem> ItemClass, const int32 Quantity)
+{
+	//clients may only touch the items of inventories the server doesn't replicate
+	if (!ItemClass || Quantity <= 0 || !GetOwner() || (!GetOwner()->HasAuthority() && GetIsReplicated())) {
+		return nullptr;
+	}
+
+	UItem* NewItem = NewObject<UItem>(GetOwner(), ItemClass);
+	NewItem->World = GetWorld();
+	NewItem->SetQuantity(Quantity);
+	NewItem->OwningInventory = this;
+	NewItem->AddedToInventory(this);
+	Items.Add(NewItem);
+	NewItem->MarkDirtyForReplication();
+
+	return NewItem;
+}
+
+void UInventoryComponent::ClearItems()
+{
+	if (GetOwner() && (GetOwner()->HasAuthority() || !GetIsReplicated())) {
+		Items.Empty();
+		ReplicatedItemKey++;
+	}
+}
+
 bool UInventoryComponent::HasItem(TSubclassOf<class UItem> ItemClass, const int32 Quantity /*= 1*/) const
 {
 	if (UItem* ItemToFind = FindItemByClass(ItemClass)) {
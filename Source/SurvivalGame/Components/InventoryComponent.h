@@ -97,6 +97,15 @@ public:
 	UFUNCTION(BlueprintCallable, Category="Inventory")
 	bool RemoveItem(class UItem* Item);
 
+	/**
+	 * Add a stack as is, without capacity, weight or stacking checks. For contents that were already checked, ie loot rolled from a seed.
+	 * Unlike the other functions this also works on clients if the inventory doesn't replicate, so it can be rebuilt locally
+	 */
+	UItem* AddItemUnchecked(TSubclassOf<class UItem> ItemClass, const int32 Quantity);
+
+	/** Remove every item. Works on clients for inventories that don't replicate, like AddItemUnchecked */
+	void ClearItems();
+
 	/** Return true if we have given amount of item */
 	UFUNCTION(BlueprintPure, Category="Inventory")
 	bool HasItem(TSubclassOf<class UItem> ItemClass, const int32 Quantity = 1) const;
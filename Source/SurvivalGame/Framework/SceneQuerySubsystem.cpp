@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Framework/SceneQuerySubsystem.h"
+#include "Engine/World.h"
+
+static FAutoConsoleCommandWithWorld SceneQueryStatsCommand(
+	TEXT("Survival.SceneQueryStats"),
+	TEXT("Print queued/submitted/deferred/completed scene queries per category"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (USceneQuerySubsystem* SceneQuery = World ? World->GetSubsystem<USceneQuerySubsystem>() : nullptr) {
+			const UEnum* CategoryEnum = StaticEnum<ESceneQueryCategory>();
+			for (int32 i = 0; i < static_cast<int32>(ESceneQueryCategory::MAX); ++i) {
+				const ESceneQueryCategory Category = static_cast<ESceneQueryCategory>(i);
+				const FSceneQueryStats& Stats = SceneQuery->GetStats(Category);
+				UE_LOG(LogTemp, Log, TEXT("%s: %d queued, %d submitted, %d deferred, %d completed, %d waiting (peak %d)"), *CategoryEnum->GetNameStringByIndex(i),
+					Stats.Queued, Stats.Submitted, Stats.Deferred, Stats.Completed, SceneQuery->GetNumQueued(Category), Stats.PeakQueued);
+			}
+		}
+	}));
+
+USceneQuerySubsystem::USceneQuerySubsystem()
+{
+	MaxQueriesPerFrame.Add(ESceneQueryCategory::Weapon, 256); //shotgun pellets of every player on a busy server
+	MaxQueriesPerFrame.Add(ESceneQueryCategory::Melee, 32);
+	MaxQueriesPerFrame.Add(ESceneQueryCategory::Interaction, 16);
+	MaxQueriesPerFrame.Add(ESceneQueryCategory::Pickup, 32);
+	MaxQueriesPerFrame.Add(ESceneQueryCategory::Explosion, 128);
+
+	NextQueryId = 0;
+}
+
+bool USceneQuerySubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	if (!Super::ShouldCreateSubsystem(Outer)) {
+		return false;
+	}
+
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void USceneQuerySubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	SubmitQueries();
+}
+
+TStatId USceneQuerySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USceneQuerySubsystem, STATGROUP_Tickables);
+}
+
+void USceneQuerySubsystem::QueueLineTrace(const ESceneQueryCategory Category, const FVector& Start, const FVector& End, const ECollisionChannel Channel, const FCollisionQueryParams& Params, const FOnSceneQueryComplete& OnComplete, const uint32 UserData /*= 0*/)
+{
+	Enqueue(Category, { Start, End, FCollisionShape::LineShape, Channel, Params, OnComplete, UserData });
+}
+
+void USceneQuerySubsystem::QueueSweep(const ESceneQueryCategory Category, const FVector& Start, const FVector& End, const FCollisionShape& Shape, const ECollisionChannel Channel, const FCollisionQueryParams& Params, const FOnSceneQueryComplete& OnComplete, const uint32 UserData /*= 0*/)
+{
+	Enqueue(Category, { Start, End, Shape, Channel, Params, OnComplete, UserData });
+}
+
+void USceneQuerySubsystem::Enqueue(const ESceneQueryCategory Category, FSceneQueryRequest&& Request)
+{
+	const int32 CategoryIndex = static_cast<int32>(Category);
+	Queues[CategoryIndex].Add(MoveTemp(Request));
+	++Stats[CategoryIndex].Queued;
+}
+
+void USceneQuerySubsystem::SubmitQueries()
+{
+	UWorld* World = GetWorld();
+
+	if (!TraceDelegate.IsBound()) {
+		TraceDelegate.BindUObject(this, &USceneQuerySubsystem::OnTraceCompleted);
+	}
+
+	for (int32 CategoryIndex = 0; CategoryIndex < static_cast<int32>(ESceneQueryCategory::MAX); ++CategoryIndex) {
+		TArray<FSceneQueryRequest>& Queue = Queues[CategoryIndex];
+		if (Queue.Num() == 0) {
+			continue;
+		}
+
+		FSceneQueryStats& CategoryStats = Stats[CategoryIndex];
+		CategoryStats.PeakQueued = FMath::Max(CategoryStats.PeakQueued, Queue.Num());
+
+		const ESceneQueryCategory Category = static_cast<ESceneQueryCategory>(CategoryIndex);
+		const int32* Budget = MaxQueriesPerFrame.Find(Category);
+		const int32 NumToSubmit = Budget ? FMath::Min(Queue.Num(), FMath::Max(*Budget, 1)) : Queue.Num();
+
+		for (int32 i = 0; i < NumToSubmit; ++i) {
+			FSceneQueryRequest& Request = Queue[i];
+
+			const uint32 QueryId = NextQueryId++;
+			PendingQueries.Add(QueryId, { MoveTemp(Request.OnComplete), Request.UserData, Category });
+
+			//async queries requested this frame are run together by physics
+			if (Request.Shape.IsLine()) {
+				World->AsyncLineTraceByChannel(EAsyncTraceType::Single, Request.Start, Request.End, Request.Channel, Request.Params, FCollisionResponseParams::DefaultResponseParam, &TraceDelegate, QueryId);
+			}
+			else {
+				World->AsyncSweepByChannel(EAsyncTraceType::Single, Request.Start, Request.End, FQuat::Identity, Request.Channel, Request.Shape, Request.Params, FCollisionResponseParams::DefaultResponseParam, &TraceDelegate, QueryId);
+			}
+		}
+
+		CategoryStats.Submitted += NumToSubmit;
+		CategoryStats.Deferred += Queue.Num() - NumToSubmit;
+		Queue.RemoveAt(0, NumToSubmit, false);
+	}
+}
+
+void USceneQuerySubsystem::OnTraceCompleted(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum)
+{
+	FPendingQuery PendingQuery;
+	if (!PendingQueries.RemoveAndCopyValue(TraceDatum.UserData, PendingQuery)) {
+		return;
+	}
+
+	FSceneQueryResult Result;
+	Result.UserData = PendingQuery.UserData;
+	if (TraceDatum.OutHits.Num() > 0) {
+		Result.Hit = TraceDatum.OutHits[0];
+		Result.bBlockingHit = Result.Hit.bBlockingHit;
+	}
+
+	++Stats[static_cast<int32>(PendingQuery.Category)].Completed;
+
+	//callers bind to UObjects, so a query of something destroyed meanwhile just does nothing
+	PendingQuery.OnComplete.ExecuteIfBound(Result);
+}
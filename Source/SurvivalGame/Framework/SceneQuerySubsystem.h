@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "SceneQuerySubsystem.generated.h"
+
+/** Who asked for a scene query. Each category has its own budget and stats */
+UENUM(BlueprintType)
+enum class ESceneQueryCategory : uint8 {
+	Weapon,
+	Melee,
+	Interaction,
+	Pickup,
+	Explosion,
+	MAX UMETA(Hidden)
+};
+
+/** Result of a queued scene query */
+struct FSceneQueryResult {
+	/** first blocking hit. Only meaningful if bBlockingHit is set */
+	FHitResult Hit;
+
+	bool bBlockingHit = false;
+
+	/** value given when the query was queued, ie a shot index */
+	uint32 UserData = 0;
+};
+
+DECLARE_DELEGATE_OneParam(FOnSceneQueryComplete, const FSceneQueryResult&);
+
+/** Per category counters, to see what queries cost and whether a budget is too small */
+struct FSceneQueryStats {
+	/** queries queued by gameplay code */
+	int32 Queued = 0;
+	/** queries handed to physics */
+	int32 Submitted = 0;
+	/** times a query had to wait a frame because the category was over budget */
+	int32 Deferred = 0;
+	/** callbacks run */
+	int32 Completed = 0;
+	/** most queries waiting in the category at the start of a frame */
+	int32 PeakQueued = 0;
+};
+
+/**
+ * Collects line traces and sweeps from gameplay code and submits them as one async batch per frame, calling back when the results are in.
+ * Every category gets a budget of queries per frame. Whatever doesn't fit waits for the next frame, in order.
+ * Query cost of weapons, melee, interaction and explosions shows up in one place (Survival.SceneQueryStats).
+ */
+UCLASS(Config = Game)
+class SURVIVALGAME_API USceneQuerySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	USceneQuerySubsystem();
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Queue a line trace for the first blocking hit. OnComplete runs once physics has the result, usually next frame */
+	void QueueLineTrace(const ESceneQueryCategory Category, const FVector& Start, const FVector& End, const ECollisionChannel Channel, const FCollisionQueryParams& Params, const FOnSceneQueryComplete& OnComplete, const uint32 UserData = 0);
+
+	/** Queue a shape sweep for the first blocking hit. OnComplete runs once physics has the result, usually next frame */
+	void QueueSweep(const ESceneQueryCategory Category, const FVector& Start, const FVector& End, const FCollisionShape& Shape, const ECollisionChannel Channel, const FCollisionQueryParams& Params, const FOnSceneQueryComplete& OnComplete, const uint32 UserData = 0);
+
+	const FSceneQueryStats& GetStats(const ESceneQueryCategory Category) const { return Stats[static_cast<int32>(Category)]; }
+
+	/** Get how many queries of the category are waiting to be submitted */
+	int32 GetNumQueued(const ESceneQueryCategory Category) const { return Queues[static_cast<int32>(Category)].Num(); }
+
+protected:
+	/** max queries of a category submitted per frame. Categories not listed have no limit */
+	UPROPERTY(Config)
+	TMap<ESceneQueryCategory, int32> MaxQueriesPerFrame;
+
+	struct FSceneQueryRequest {
+		FVector Start;
+		FVector End;
+		/** line trace if the shape is a line */
+		FCollisionShape Shape;
+		ECollisionChannel Channel;
+		FCollisionQueryParams Params;
+		FOnSceneQueryComplete OnComplete;
+		uint32 UserData;
+	};
+
+	struct FPendingQuery {
+		FOnSceneQueryComplete OnComplete;
+		uint32 UserData;
+		ESceneQueryCategory Category;
+	};
+
+	/** queries waiting to be submitted, per category */
+	TArray<FSceneQueryRequest> Queues[static_cast<int32>(ESceneQueryCategory::MAX)];
+
+	FSceneQueryStats Stats[static_cast<int32>(ESceneQueryCategory::MAX)];
+
+	/** submitted queries by the id given to physics */
+	TMap<uint32, FPendingQuery> PendingQueries;
+
+	uint32 NextQueryId;
+
+	FTraceDelegate TraceDelegate;
+
+	void Enqueue(const ESceneQueryCategory Category, FSceneQueryRequest&& Request);
+
+	void SubmitQueries();
+
+	void OnTraceCompleted(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum);
+};
@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Player/CharacterSignificanceSubsystem.h"
+#include "Player/SurvivalCharacter.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/World.h"
+
+UCharacterSignificanceSubsystem::UCharacterSignificanceSubsystem()
+{
+	UpdateInterval = 0.2f;
+	MaxSignificanceDistance = 15000.f; //150 meter
+	AlwaysRelevantDistance = 1500.f;
+	ViewConeHalfAngle = 60.f;
+	OffScreenScale = 0.3f;
+	CombatActivityWindow = 3.f;
+	CombatBonus = 0.3f;
+	HighThreshold = 0.7f;
+	MediumThreshold = 0.4f;
+	LowThreshold = 0.1f;
+
+	TimeSinceLastUpdate = 0.f;
+}
+
+bool UCharacterSignificanceSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	if (!Super::ShouldCreateSubsystem(Outer)) {
+		return false;
+	}
+
+	//dedicated server doesn't render anything, so nothing is significant to it
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld() && !IsRunningDedicatedServer();
+}
+
+void UCharacterSignificanceSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	TimeSinceLastUpdate += DeltaTime;
+	if (TimeSinceLastUpdate >= UpdateInterval) {
+		TimeSinceLastUpdate = 0.f;
+		UpdateSignificance();
+	}
+}
+
+TStatId UCharacterSignificanceSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCharacterSignificanceSubsystem, STATGROUP_Tickables);
+}
+
+void UCharacterSignificanceSubsystem::RegisterCharacter(ASurvivalCharacter* Character)
+{
+	if (Character) {
+		Characters.AddUnique(Character);
+	}
+}
+
+void UCharacterSignificanceSubsystem::UnregisterCharacter(ASurvivalCharacter* Character)
+{
+	Characters.RemoveSingleSwap(Character);
+}
+
+float UCharacterSignificanceSubsystem::ScoreCharacter(const ASurvivalCharacter* Character, const FVector& ViewLocation, const FVector& ViewDirection) const
+{
+	if (!Character) {
+		return 0.f;
+	}
+
+	const FVector ToCharacter = Character->GetActorLocation() - ViewLocation;
+	const float Distance = ToCharacter.Size();
+
+	float Score = 1.f - FMath::Clamp(Distance / MaxSignificanceDistance, 0.f, 1.f);
+
+	//characters we can't see are way less important, unless they're right next to us
+	const float ViewDot = FVector::DotProduct(ViewDirection, ToCharacter.GetSafeNormal());
+	if (ViewDot < FMath::Cos(FMath::DegreesToRadians(ViewConeHalfAngle)) && Distance > AlwaysRelevantDistance) {
+		Score *= OffScreenScale;
+	}
+
+	//someone shooting is more important than someone walking around
+	if (Character->GetWorld()->TimeSince(Character->GetLastCombatActivityTime()) < CombatActivityWindow) {
+		Score += CombatBonus;
+	}
+
+	return Score;
+}
+
+bool UCharacterSignificanceSubsystem::GetLocalViewPoint(FVector& OutLocation, FVector& OutDirection) const
+{
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It) {
+		if (APlayerController* PC = It->Get()) {
+			if (PC->IsLocalController()) {
+				FRotator ViewRotation;
+				PC->GetPlayerViewPoint(OutLocation, ViewRotation);
+				OutDirection = ViewRotation.Vector();
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+ECharacterSignificance UCharacterSignificanceSubsystem::GetSignificanceForScore(const float Score) const
+{
+	if (Score >= HighThreshold) {
+		return ECharacterSignificance::CS_High;
+	}
+	else if (Score >= MediumThreshold) {
+		return ECharacterSignificance::CS_Medium;
+	}
+	else if (Score >= LowThreshold) {
+		return ECharacterSignificance::CS_Low;
+	}
+	return ECharacterSignificance::CS_Culled;
+}
+
+void UCharacterSignificanceSubsystem::UpdateSignificance()
+{
+	FVector ViewLocation;
+	FVector ViewDirection;
+	if (!GetLocalViewPoint(ViewLocation, ViewDirection)) {
+		return;
+	}
+
+	for (int32 i = Characters.Num() - 1; i >= 0; --i) {
+		ASurvivalCharacter* Character = Characters[i].Get();
+		if (!Character) {
+			Characters.RemoveAtSwap(i);
+			continue;
+		}
+
+		//our own character is always fully significant
+		if (Character->IsLocallyControlled()) {
+			Character->SetSignificance(ECharacterSignificance::CS_High);
+			continue;
+		}
+
+		const float DistanceSq = FVector::DistSquared(Character->GetActorLocation(), ViewLocation);
+		const ECharacterSignificance Significance = DistanceSq <= FMath::Square(AlwaysRelevantDistance) ? ECharacterSignificance::CS_High : GetSignificanceForScore(ScoreCharacter(Character, ViewLocation, ViewDirection));
+
+		Character->SetSignificance(Significance);
+	}
+}
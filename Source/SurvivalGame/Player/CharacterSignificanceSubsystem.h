@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CharacterSignificanceSubsystem.generated.h"
+
+class ASurvivalCharacter;
+
+/** How much a remote character matters to the local viewer. Lower values get cheaper ticking, animation and cosmetics */
+UENUM(BlueprintType)
+enum class ECharacterSignificance : uint8 {
+	CS_High UMETA(DisplayName = "High"),
+	CS_Medium UMETA(DisplayName = "Medium"),
+	CS_Low UMETA(DisplayName = "Low"),
+	CS_Culled UMETA(DisplayName = "Culled")
+};
+
+/**
+ * Scores every remote ASurvivalCharacter against the local player's view by distance, view angle and combat activity,
+ * and pushes the resulting significance level to the character so it can scale down its tick, animation and cosmetic work.
+ * Only created on machines that render (never on dedicated servers).
+ */
+UCLASS(Config = Game)
+class SURVIVALGAME_API UCharacterSignificanceSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UCharacterSignificanceSubsystem();
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void RegisterCharacter(ASurvivalCharacter* Character);
+	void UnregisterCharacter(ASurvivalCharacter* Character);
+
+	/** Get the significance score(0-1+) of the character from the given view. Exposed so other systems can score arbitrary locations */
+	float ScoreCharacter(const ASurvivalCharacter* Character, const FVector& ViewLocation, const FVector& ViewDirection) const;
+
+protected:
+	/** how often in seconds we re-evaluate significance. Zero to evaluate every tick */
+	UPROPERTY(Config)
+	float UpdateInterval;
+
+	/** characters further than this are scored as zero distance significance */
+	UPROPERTY(Config)
+	float MaxSignificanceDistance;
+
+	/** characters closer than this are always high significance, even behind the camera */
+	UPROPERTY(Config)
+	float AlwaysRelevantDistance;
+
+	/** half angle in degrees of the view cone we consider "on screen" */
+	UPROPERTY(Config)
+	float ViewConeHalfAngle;
+
+	/** multiplier applied to characters outside the view cone */
+	UPROPERTY(Config)
+	float OffScreenScale;
+
+	/** seconds after firing/punching/taking damage that a character is considered in combat */
+	UPROPERTY(Config)
+	float CombatActivityWindow;
+
+	/** score bonus for characters in combat */
+	UPROPERTY(Config)
+	float CombatBonus;
+
+	/** score thresholds for each significance bucket */
+	UPROPERTY(Config)
+	float HighThreshold;
+
+	UPROPERTY(Config)
+	float MediumThreshold;
+
+	UPROPERTY(Config)
+	float LowThreshold;
+
+	/** Get local player's view. Return false if there's no local player to score against */
+	bool GetLocalViewPoint(FVector& OutLocation, FVector& OutDirection) const;
+
+	ECharacterSignificance GetSignificanceForScore(const float Score) const;
+
+	void UpdateSignificance();
+
+	TArray<TWeakObjectPtr<ASurvivalCharacter>> Characters;
+
+	float TimeSinceLastUpdate;
+};
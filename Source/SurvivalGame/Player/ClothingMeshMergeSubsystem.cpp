@@ -0,0 +1,150 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Player/ClothingMeshMergeSubsystem.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/World.h"
+#include "Materials/MaterialInterface.h"
+#include "SkeletalMeshMerge.h"
+
+UClothingMeshMergeSubsystem::UClothingMeshMergeSubsystem()
+{
+	MaxMergesPerFrame = 1;
+	MaxCachedMeshes = 32;
+}
+
+bool UClothingMeshMergeSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	if (!Super::ShouldCreateSubsystem(Outer)) {
+		return false;
+	}
+
+	//merging is purely cosmetic
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld() && !IsRunningDedicatedServer();
+}
+
+void UClothingMeshMergeSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	for (int32 MergeCount = 0; MergeCount < MaxMergesPerFrame && PendingMerges.Num() > 0; ++MergeCount) {
+		FPendingClothingMerge Request = MoveTemp(PendingMerges[0]);
+		PendingMerges.RemoveAt(0);
+
+		USkeletalMesh* MergedMesh = BuildMergedMesh(Request);
+		if (MergedMesh) {
+			AddToCache(Request.Key, MergedMesh);
+		}
+
+		for (FOnClothingMeshMerged& Callback : Request.Callbacks) {
+			Callback.ExecuteIfBound(MergedMesh);
+		}
+	}
+}
+
+TStatId UClothingMeshMergeSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UClothingMeshMergeSubsystem, STATGROUP_Tickables);
+}
+
+void UClothingMeshMergeSubsystem::RequestMergedMesh(const TArray<FClothingMergeSource>& Sources, FOnClothingMeshMerged Callback)
+{
+	FClothingMergeKey Key;
+	for (const FClothingMergeSource& Source : Sources) {
+		Key.Assets.Add(Source.Mesh);
+		Key.Assets.Add(Source.OverrideMaterial);
+	}
+
+	//someone already wears this combination
+	if (FMergedMeshCacheEntry* CachedEntry = MergedMeshCache.Find(Key)) {
+		CachedEntry->LastUsedFrame = GFrameCounter;
+		Callback.ExecuteIfBound(CachedEntry->Mesh);
+		return;
+	}
+
+	//someone already asked for this combination this frame, share the merge
+	for (FPendingClothingMerge& PendingMerge : PendingMerges) {
+		if (PendingMerge.Key == Key) {
+			PendingMerge.Callbacks.Add(MoveTemp(Callback));
+			return;
+		}
+	}
+
+	FPendingClothingMerge& NewRequest = PendingMerges.AddDefaulted_GetRef();
+	NewRequest.Key = MoveTemp(Key);
+	for (const FClothingMergeSource& Source : Sources) {
+		NewRequest.Meshes.Add(Source.Mesh);
+		NewRequest.OverrideMaterials.Add(Source.OverrideMaterial);
+	}
+	NewRequest.Callbacks.Add(MoveTemp(Callback));
+}
+
+USkeletalMesh* UClothingMeshMergeSubsystem::BuildMergedMesh(const FPendingClothingMerge& Request)
+{
+	TArray<USkeletalMesh*> SourceMeshes;
+	for (const TWeakObjectPtr<USkeletalMesh>& Mesh : Request.Meshes) {
+		if (!Mesh.IsValid()) {
+			return nullptr;
+		}
+		SourceMeshes.Add(Mesh.Get());
+	}
+
+	if (SourceMeshes.Num() == 0) {
+		return nullptr;
+	}
+
+	USkeletalMesh* MergedMesh = NewObject<USkeletalMesh>(this, NAME_None, RF_Transient);
+	MergedMesh->SetSkeleton(SourceMeshes[0]->GetSkeleton());
+	//first mesh is the head(character mesh) so it carries the ragdoll physics asset
+	MergedMesh->SetPhysicsAsset(SourceMeshes[0]->GetPhysicsAsset());
+
+	FSkeletalMeshMerge Merger(MergedMesh, SourceMeshes, TArray<FSkelMeshMergeSectionMapping>(), 0);
+	if (!Merger.DoMerge()) {
+		UE_LOG(LogTemp, Warning, TEXT("Failed to merge clothing meshes"));
+		return nullptr;
+	}
+
+	//clothing materials go on the last material slot of the source mesh, so swap that one in the merged mesh
+	TArray<FSkeletalMaterial>& MergedMaterials = MergedMesh->GetMaterials();
+	for (int32 i = 0; i < SourceMeshes.Num(); ++i) {
+		UMaterialInterface* OverrideMaterial = Request.OverrideMaterials[i].Get();
+		const TArray<FSkeletalMaterial>& SourceMaterials = SourceMeshes[i]->GetMaterials();
+		if (OverrideMaterial && SourceMaterials.Num() > 0) {
+			const UMaterialInterface* ReplacedMaterial = SourceMaterials.Last().MaterialInterface;
+			for (FSkeletalMaterial& MergedMaterial : MergedMaterials) {
+				if (MergedMaterial.MaterialInterface == ReplacedMaterial) {
+					MergedMaterial.MaterialInterface = OverrideMaterial;
+				}
+			}
+		}
+	}
+
+	return MergedMesh;
+}
+
+void UClothingMeshMergeSubsystem::AddToCache(const FClothingMergeKey& Key, USkeletalMesh* MergedMesh)
+{
+	if (MergedMeshCache.Num() >= MaxCachedMeshes) {
+		//evict least recently used. Characters still wearing it keep it alive through their mesh component
+		const FClothingMergeKey* OldestKey = nullptr;
+		uint64 OldestFrame = MAX_uint64;
+		for (const TPair<FClothingMergeKey, FMergedMeshCacheEntry>& Entry : MergedMeshCache) {
+			if (Entry.Value.LastUsedFrame < OldestFrame) {
+				OldestFrame = Entry.Value.LastUsedFrame;
+				OldestKey = &Entry.Key;
+			}
+		}
+
+		if (OldestKey) {
+			const FClothingMergeKey KeyToEvict = *OldestKey;
+			CachedMeshes.RemoveSingleSwap(MergedMeshCache.FindChecked(KeyToEvict).Mesh);
+			MergedMeshCache.Remove(KeyToEvict);
+		}
+	}
+
+	FMergedMeshCacheEntry& NewEntry = MergedMeshCache.Add(Key);
+	NewEntry.Mesh = MergedMesh;
+	NewEntry.LastUsedFrame = GFrameCounter;
+	CachedMeshes.Add(MergedMesh);
+}
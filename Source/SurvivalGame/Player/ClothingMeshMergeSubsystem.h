@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ClothingMeshMergeSubsystem.generated.h"
+
+class USkeletalMesh;
+class UMaterialInterface;
+
+DECLARE_DELEGATE_OneParam(FOnClothingMeshMerged, USkeletalMesh* /*MergedMesh*/);
+
+/** One slot of the body to merge. OverrideMaterial replaces the last material of the slot mesh, like EquipClothing does */
+struct FClothingMergeSource {
+	USkeletalMesh* Mesh = nullptr;
+	UMaterialInterface* OverrideMaterial = nullptr;
+};
+
+/** Identifies a combination of slot meshes and materials. Identical loadouts produce identical keys */
+struct FClothingMergeKey {
+	TArray<const UObject*, TInlineAllocator<16>> Assets;
+
+	bool operator==(const FClothingMergeKey& Other) const { return Assets == Other.Assets; }
+
+	friend uint32 GetTypeHash(const FClothingMergeKey& Key)
+	{
+		uint32 Hash = 0;
+		for (const UObject* Asset : Key.Assets) {
+			Hash = HashCombine(Hash, GetTypeHash(Asset));
+		}
+		return Hash;
+	}
+};
+
+/**
+ * Merges the modular body meshes of a character into a single skeletal mesh, so remote characters skin one mesh instead of eight.
+ * Results are cached by equipment combination so every character wearing the same loadout shares one merged mesh.
+ * Merges are time sliced across frames, callers keep their per-slot components visible until the callback fires.
+ * Source meshes must have CPU access enabled on their LODs for merging to work in cooked builds.
+ */
+UCLASS(Config = Game)
+class SURVIVALGAME_API UClothingMeshMergeSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UClothingMeshMergeSubsystem();
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/**
+	 * Request a merged mesh for the given slots. Sources must be in a stable slot order so identical loadouts hit the cache.
+	 * Callback is executed right away if the combination is cached, otherwise on a later frame. Merged mesh is null if merge failed.
+	 */
+	void RequestMergedMesh(const TArray<FClothingMergeSource>& Sources, FOnClothingMeshMerged Callback);
+
+protected:
+	/** how many merges we're allowed to build in a single frame */
+	UPROPERTY(Config)
+	int32 MaxMergesPerFrame;
+
+	/** max number of merged meshes kept around. Least recently used combination gets evicted first */
+	UPROPERTY(Config)
+	int32 MaxCachedMeshes;
+
+	/** keeps cached meshes alive */
+	UPROPERTY(Transient)
+	TArray<USkeletalMesh*> CachedMeshes;
+
+	struct FMergedMeshCacheEntry {
+		USkeletalMesh* Mesh = nullptr;
+		uint64 LastUsedFrame = 0;
+	};
+
+	struct FPendingClothingMerge {
+		FClothingMergeKey Key;
+		TArray<TWeakObjectPtr<USkeletalMesh>> Meshes;
+		TArray<TWeakObjectPtr<UMaterialInterface>> OverrideMaterials;
+		TArray<FOnClothingMeshMerged> Callbacks;
+	};
+
+	TMap<FClothingMergeKey, FMergedMeshCacheEntry> MergedMeshCache;
+
+	TArray<FPendingClothingMerge> PendingMerges;
+
+	/** build merged mesh for the request. Return null if any source went away or merging failed */
+	USkeletalMesh* BuildMergedMesh(const FPendingClothingMerge& Request);
+
+	void AddToCache(const FClothingMergeKey& Key, USkeletalMesh* MergedMesh);
+};
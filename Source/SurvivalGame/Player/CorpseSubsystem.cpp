@@ -0,0 +1,217 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Player/CorpseSubsystem.h"
+#include "Player/SurvivalCharacter.h"
+#include "World/LootableChest.h"
+#include "Components/InteractionComponent.h"
+#include "Components/InventoryComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "Items/Item.h"
+#include "Engine/World.h"
+
+UCorpseSubsystem::UCorpseSubsystem()
+{
+	UpdateInterval = 0.25f;
+	MaxSimulatedRagdolls = 8;
+	SettledSpeed = 15.f;
+	MinSimulateTime = 1.5f;
+	MaxSimulateTime = 10.f;
+	ProxyConversionDelay = 20.f;
+	ProxyLifeSpan = 120.f;
+	LootedLifeSpan = 120.f;
+
+	TimeSinceLastUpdate = 0.f;
+}
+
+bool UCorpseSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	if (!Super::ShouldCreateSubsystem(Outer)) {
+		return false;
+	}
+
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UCorpseSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	TimeSinceLastUpdate += DeltaTime;
+	if (TimeSinceLastUpdate >= UpdateInterval) {
+		TimeSinceLastUpdate = 0.f;
+		UpdateCorpses();
+	}
+}
+
+TStatId UCorpseSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCorpseSubsystem, STATGROUP_Tickables);
+}
+
+void UCorpseSubsystem::RegisterCorpse(ASurvivalCharacter* Corpse)
+{
+	if (!Corpse || !Corpse->HasAuthority()) {
+		return;
+	}
+
+	//keep the original death time if the body gets killed again
+	if (Corpses.ContainsByPredicate([Corpse](const FCorpseEntry& Entry) { return Entry.Corpse.Get() == Corpse; })) {
+		return;
+	}
+
+	FCorpseEntry& Entry = Corpses.AddDefaulted_GetRef();
+	Entry.Corpse = Corpse;
+	Entry.DeathTime = GetWorld()->GetTimeSeconds();
+}
+
+void UCorpseSubsystem::NotifyLooted(AActor* LootedActor)
+{
+	for (FCorpseEntry& Entry : Corpses) {
+		if (Entry.Corpse.Get() == LootedActor) {
+			Entry.LastLootedTime = GetWorld()->GetTimeSeconds();
+			return;
+		}
+	}
+
+	//proxies are plain actors, so just push their lifespan back like looting a player used to
+	for (const TWeakObjectPtr<ALootableChest>& Proxy : Proxies) {
+		if (Proxy.Get() == LootedActor) {
+			LootedActor->SetLifeSpan(FMath::Max(LootedActor->GetLifeSpan(), LootedLifeSpan));
+			return;
+		}
+	}
+}
+
+void UCorpseSubsystem::UpdateCorpses()
+{
+	const float TimeSeconds = GetWorld()->GetTimeSeconds();
+
+	Proxies.RemoveAllSwap([](const TWeakObjectPtr<ALootableChest>& Proxy) { return !Proxy.IsValid(); });
+
+	int32 NumSimulating = 0;
+	for (int32 i = Corpses.Num() - 1; i >= 0; --i) {
+		FCorpseEntry& Entry = Corpses[i];
+		ASurvivalCharacter* Corpse = Entry.Corpse.Get();
+		if (!Corpse) {
+			Corpses.RemoveAt(i);
+			continue;
+		}
+
+		const float TimeSinceDeath = TimeSeconds - Entry.DeathTime;
+
+		if (TimeSinceDeath >= ProxyConversionDelay && ConvertCorpse(Entry)) {
+			Corpses.RemoveAt(i);
+			continue;
+		}
+
+		if (!Entry.bFrozen) {
+			const float Speed = Corpse->GetMesh()->GetPhysicsLinearVelocity().Size();
+			if (TimeSinceDeath >= MaxSimulateTime || (TimeSinceDeath >= MinSimulateTime && Speed < SettledSpeed)) {
+				FreezeCorpse(Entry);
+			}
+			else {
+				++NumSimulating;
+			}
+		}
+	}
+
+	//over budget, freeze oldest ragdolls even if they are still moving
+	for (int32 i = 0; i < Corpses.Num() && NumSimulating > MaxSimulatedRagdolls; ++i) {
+		if (!Corpses[i].bFrozen) {
+			FreezeCorpse(Corpses[i]);
+			--NumSimulating;
+		}
+	}
+}
+
+void UCorpseSubsystem::FreezeCorpse(FCorpseEntry& Entry)
+{
+	Entry.bFrozen = true;
+
+	ASurvivalCharacter* Corpse = Entry.Corpse.Get();
+	USkeletalMeshComponent* CorpseMesh = Corpse->GetMesh();
+
+	//stop simulating and stop evaluating the skeleton, so bodies keep the pose they're lying in
+	CorpseMesh->PutAllRigidBodiesToSleep();
+	CorpseMesh->bNoSkeletonUpdate = true;
+	CorpseMesh->SetComponentTickEnabled(false);
+	CorpseMesh->SetSimulatePhysics(false);
+	CorpseMesh->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+	Corpse->SetActorTickEnabled(false);
+}
+
+bool UCorpseSubsystem::IsBeingLooted(const ASurvivalCharacter* Corpse) const
+{
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It) {
+		if (APlayerController* PC = It->Get()) {
+			if (ASurvivalCharacter* Looter = Cast<ASurvivalCharacter>(PC->GetPawn())) {
+				if (Looter->GetLootSource() && Looter->GetLootSource() == Corpse->PlayerInventory) {
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+bool UCorpseSubsystem::ConvertCorpse(FCorpseEntry& Entry)
+{
+	ASurvivalCharacter* Corpse = Entry.Corpse.Get();
+	const float TimeSeconds = GetWorld()->GetTimeSeconds();
+
+	//never pull the body out from under someone looting it
+	if (IsBeingLooted(Corpse)) {
+		return false;
+	}
+
+	const bool bHasLoot = Corpse->PlayerInventory && Corpse->PlayerInventory->GetItems().Num() > 0;
+
+	if (bHasLoot && CorpseProxyClass) {
+		const FTransform ProxyTransform(FRotator(0.f, Corpse->GetActorRotation().Yaw, 0.f), Corpse->GetMesh()->Bounds.Origin);
+
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.bNoFail = true;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+		SpawnParams.bDeferConstruction = true;
+
+		if (ALootableChest* Proxy = GetWorld()->SpawnActor<ALootableChest>(CorpseProxyClass, ProxyTransform, SpawnParams)) {
+			//proxy only holds what the player had, it must not roll loot of its own
+			Proxy->LootTable = nullptr;
+			Proxy->CookedLootTable = nullptr;
+			//clients couldn't roll the player's items from a seed, they have to be sent
+			Proxy->bReplicateLootBySeed = false;
+			Proxy->FinishSpawning(ProxyTransform);
+
+			//the corpse is destroyed right after, so everything has to fit: make room for all of it and copy stacks as they are.
+			//TryAddItem would drop what's over the proxy's limits, and any stack of a class whose first stack is already full
+			UInventoryComponent* CorpseInventory = Corpse->PlayerInventory;
+			Proxy->Inventory->SetCapacity(FMath::Max(Proxy->Inventory->GetCapacity(), CorpseInventory->GetItems().Num()));
+			Proxy->Inventory->SetWeightCapacity(FMath::Max(Proxy->Inventory->GetWeightCapacity(), CorpseInventory->GetCurrentWeight()));
+
+			for (UItem* Item : CorpseInventory->GetItems()) {
+				if (Item) {
+					Proxy->Inventory->AddItemUnchecked(Item->GetClass(), Item->GetQuantity());
+				}
+			}
+
+			Proxy->LootInteraction->SetInteractableNameText(Corpse->LootPlayerInteraction->InteractableNameText);
+			Proxy->SetLifeSpan(ProxyLifeSpan);
+			Proxies.Add(Proxy);
+
+			Corpse->Destroy();
+			return true;
+		}
+	}
+
+	//nothing to keep around a proxy for, remove the corpse once nobody looted it for a while
+	const float RemoveTime = FMath::Max(Entry.DeathTime + ProxyConversionDelay + (bHasLoot ? ProxyLifeSpan : 0.f), Entry.LastLootedTime + LootedLifeSpan);
+	if (TimeSeconds >= RemoveTime) {
+		Corpse->Destroy();
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CorpseSubsystem.generated.h"
+
+class ASurvivalCharacter;
+class ALootableChest;
+
+/**
+ * Server side bookkeeping for dead characters.
+ * Caps the number of ragdolls simulated at once, freezes ragdolls into a static pose once they settle,
+ * and converts old corpses into a cheap loot container proxy that keeps the dead player's inventory.
+ */
+UCLASS(Config = Game)
+class SURVIVALGAME_API UCorpseSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UCorpseSubsystem();
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Start tracking a character that just died. Server only */
+	void RegisterCorpse(ASurvivalCharacter* Corpse);
+
+	/** Someone started looting the actor. Keeps a corpse around as a character, or extends the lifetime of a corpse proxy */
+	void NotifyLooted(AActor* LootedActor);
+
+protected:
+	/** how often in seconds corpses are checked for settling and conversion */
+	UPROPERTY(Config)
+	float UpdateInterval;
+
+	/** max number of ragdolls the server simulates at the same time. Oldest gets frozen first */
+	UPROPERTY(Config)
+	int32 MaxSimulatedRagdolls;
+
+	/** ragdoll is considered settled when its root body is slower than this (cm/s) */
+	UPROPERTY(Config)
+	float SettledSpeed;
+
+	/** minimum time a ragdoll simulates before it can be considered settled, so it doesn't freeze at the top of its fall */
+	UPROPERTY(Config)
+	float MinSimulateTime;
+
+	/** ragdolls still moving after this long are frozen anyway */
+	UPROPERTY(Config)
+	float MaxSimulateTime;
+
+	/** seconds after death before the corpse gets replaced by a loot proxy */
+	UPROPERTY(Config)
+	float ProxyConversionDelay;
+
+	/** seconds the loot proxy lives. Corpses with nothing to loot are removed instead of converted */
+	UPROPERTY(Config)
+	float ProxyLifeSpan;
+
+	/** seconds a corpse or proxy is kept alive after someone last looted it */
+	UPROPERTY(Config)
+	float LootedLifeSpan;
+
+	/** Loot container spawned in place of old corpses. Without one, corpses are frozen and removed after the proxy lifespan */
+	UPROPERTY(Config)
+	TSubclassOf<ALootableChest> CorpseProxyClass;
+
+	struct FCorpseEntry {
+		TWeakObjectPtr<ASurvivalCharacter> Corpse;
+		float DeathTime = 0.f;
+		float LastLootedTime = -BIG_NUMBER;
+		bool bFrozen = false;
+	};
+
+	/** corpses in order of death, oldest first */
+	TArray<FCorpseEntry> Corpses;
+
+	TArray<TWeakObjectPtr<ALootableChest>> Proxies;
+
+	float TimeSinceLastUpdate;
+
+	void UpdateCorpses();
+
+	/** Stop simulating the ragdoll and keep its current pose */
+	void FreezeCorpse(FCorpseEntry& Entry);
+
+	/** Is any player currently looting the corpse */
+	bool IsBeingLooted(const ASurvivalCharacter* Corpse) const;
+
+	/** Replace the corpse with a loot proxy holding its inventory. Return false if the corpse has to stay */
+	bool ConvertCorpse(FCorpseEntry& Entry);
+};
@@ -5,16 +5,25 @@
 #include "Components/InteractionComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "Components/InventoryComponent.h"
+#include "Components/AudioPoolComponent.h"
 #include "Components/SkeletalMeshComponent.h"
 #include "Weapons/MeleeDamage.h"
 #include "Net/UnrealNetwork.h"
 #include "World/Pickup.h"
+#include "World/PickupDropSubsystem.h"
+#include "World/LootableChest.h"
 #include "Items/EquippableItem.h"
 #include "Items/ClothingItem.h"
 #include "Items/WeaponItem.h"
 #include "Items/ThrowableItem.h"
 #include "Materials/MaterialInstance.h"
 #include "Player/SurvivalPlayerController.h"
+#include "Player/CharacterSignificanceSubsystem.h"
+#include "Player/ClothingMeshMergeSubsystem.h"
+#include "Player/CorpseSubsystem.h"
+#include "Weapons/CombatFXSubsystem.h"
+#include "Framework/SceneQuerySubsystem.h"
+#include "Weapons/HitRegistrationSubsystem.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "GameFramework/PlayerState.h"
 #include "GameFramework/SpringArmComponent.h"
@@ -42,28 +51,16 @@ ASurvivalCharacter::ASurvivalCharacter()
 	PlayerCameraComponent = CreateDefaultSubobject<UCameraComponent>(TEXT("CameraComponent"));
 	PlayerCameraComponent->SetupAttachment(SpringArmComponent);
 	PlayerCameraComponent->bUsePawnControlRotation = true;
-	 
-	HelmetMesh = PlayerMeshes.Add(EEquippableSlot::EIS_Helmet, CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("HelmetMesh")));
-	ChestMesh = PlayerMeshes.Add(EEquippableSlot::EIS_Chest, CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("ChestMesh")));
-	LegsMesh = PlayerMeshes.Add(EEquippableSlot::EIS_Legs, CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("LegsMesh")));
-	FeetMesh = PlayerMeshes.Add(EEquippableSlot::EIS_Feet, CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("FeetMesh")));
-	VestMesh = PlayerMeshes.Add(EEquippableSlot::EIS_Vest, CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("VestMesh")));
-	HandsMesh = PlayerMeshes.Add(EEquippableSlot::EIS_Hands, CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("HandsMesh")));
-	BackpackMesh = PlayerMeshes.Add(EEquippableSlot::EIS_Backpack, CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("BackpackMesh")));
-
-	//Tell all the body meshes to use the head mesh for animation
-	for (auto& PlayerMesh : PlayerMeshes) {
-		USkeletalMeshComponent* MeshComponent = PlayerMesh.Value;
-		MeshComponent->SetupAttachment(GetMesh());
-		MeshComponent->SetMasterPoseComponent(GetMesh());
-	}
 
+	//other body slot meshes are created on demand, see GetOrCreateSlotMeshComponent
 	PlayerMeshes.Add(EEquippableSlot::EIS_Head, GetMesh());
 
 	PlayerInventory = CreateDefaultSubobject<UInventoryComponent>("PlayerInventory");
 	PlayerInventory-> SetCapacity(20);
 	PlayerInventory->SetWeightCapacity(80.f);
 
+	AudioPool = CreateDefaultSubobject<UAudioPoolComponent>("AudioPool");
+
 	LootPlayerInteraction = CreateDefaultSubobject<UInteractionComponent>("PlayerInteraction");
 	LootPlayerInteraction->InteractableActionText = LOCTEXT("LootPlayerText", "Loot");
 	LootPlayerInteraction->InteractableNameText = LOCTEXT("LootPlayerName", "Player");
@@ -85,6 +82,20 @@ ASurvivalCharacter::ASurvivalCharacter()
 	bIsAiming = false;
 	AimFOV = 70.f;
 	NonAimFOV = 100.f;
+
+	MaxPooledWeapons = 3;
+
+	bMergeClothingMeshes = false;
+	bMergedMeshActive = false;
+	bMergedMeshRebuildQueued = false;
+	MergedMeshRequestId = 0;
+
+	Significance = ECharacterSignificance::CS_High;
+	LastCombatActivityTime = -BIG_NUMBER;
+	SignificanceTickIntervals.Add(ECharacterSignificance::CS_High, 0.f);
+	SignificanceTickIntervals.Add(ECharacterSignificance::CS_Medium, 1.f / 30.f);
+	SignificanceTickIntervals.Add(ECharacterSignificance::CS_Low, 0.1f);
+	SignificanceTickIntervals.Add(ECharacterSignificance::CS_Culled, 0.25f);
 }
 
 bool ASurvivalCharacter::EquipItem(class UEquippableItem* Item)
@@ -108,17 +119,19 @@ bool ASurvivalCharacter::UnEquipItem(class UEquippableItem* Item)
 
 void ASurvivalCharacter::EquipClothing(class UClothingItem* Clothing)
 {
-	if (USkeletalMeshComponent* ClothingMesh = *PlayerMeshes.Find(Clothing->Slot)) {
+	if (USkeletalMeshComponent* ClothingMesh = GetOrCreateSlotMeshComponent(Clothing->Slot)) {
 		ClothingMesh->SetSkeletalMesh(Clothing->Mesh);
 		ClothingMesh->SetMaterial(ClothingMesh->GetMaterials().Num() - 1, Clothing->MaterialInstance);
 	}
+
+	RefreshMergedMesh();
 }
 
 void ASurvivalCharacter::UnEquipClothing(const EEquippableSlot Slot)
 {
-	if (USkeletalMeshComponent* EquippableMesh = *PlayerMeshes.Find(Slot)) {
+	if (USkeletalMeshComponent* EquippableMesh = GetSlotSkeletalMeshComponent(Slot)) {
 		//find naked body mesh and set mesh and material
-		if (USkeletalMesh* BodyMesh = *NakedMeshes.Find(Slot)) {
+		if (USkeletalMesh* BodyMesh = NakedMeshes.FindRef(Slot)) {
 			EquippableMesh->SetSkeletalMesh(BodyMesh);
 
 			//Put the material back on the body mesh(since clothing materials are on it)
@@ -133,6 +146,107 @@ void ASurvivalCharacter::UnEquipClothing(const EEquippableSlot Slot)
 			EquippableMesh->SetSkeletalMesh(nullptr);
 		}
 	}
+
+	RefreshMergedMesh();
+}
+
+void ASurvivalCharacter::RefreshMergedMesh()
+{
+	if (!bMergeClothingMeshes || GetNetMode() == NM_DedicatedServer) {
+		return;
+	}
+
+	//show per slot meshes with the new equipment until the merged one is ready
+	SetMergedMesh(nullptr);
+
+	//equipment usually changes several times in a frame(spawn, death), only merge the final loadout
+	if (!bMergedMeshRebuildQueued) {
+		bMergedMeshRebuildQueued = true;
+		GetWorldTimerManager().SetTimerForNextTick(this, &ASurvivalCharacter::RequestMergedMesh);
+	}
+}
+
+void ASurvivalCharacter::RequestMergedMesh()
+{
+	bMergedMeshRebuildQueued = false;
+	++MergedMeshRequestId;
+
+	//own body is mostly hidden for first person view and dead bodies ragdoll with their per slot meshes
+	if (IsLocallyControlled() || !IsAlive()) {
+		return;
+	}
+
+	UClothingMeshMergeSubsystem* MergeSubsystem = GetWorld()->GetSubsystem<UClothingMeshMergeSubsystem>();
+	if (!MergeSubsystem) {
+		return;
+	}
+
+	//fixed slot order so same loadouts produce the same cache key
+	static const EEquippableSlot MergeSlots[] = { EEquippableSlot::EIS_Head, EEquippableSlot::EIS_Helmet, EEquippableSlot::EIS_Chest, EEquippableSlot::EIS_Vest,
+		EEquippableSlot::EIS_Legs, EEquippableSlot::EIS_Feet, EEquippableSlot::EIS_Hands, EEquippableSlot::EIS_Backpack };
+
+	TArray<FClothingMergeSource> Sources;
+	for (const EEquippableSlot Slot : MergeSlots) {
+		FClothingMergeSource Source;
+		UClothingItem* Clothing = Cast<UClothingItem>(EquippedItems.FindRef(Slot));
+
+		//character mesh will be displaying the merged mesh, so take the head from what's worn instead
+		if (Slot == EEquippableSlot::EIS_Head) {
+			Source.Mesh = Clothing ? Clothing->Mesh : NakedMeshes.FindRef(Slot);
+		}
+		else if (USkeletalMeshComponent* SlotMesh = GetSlotSkeletalMeshComponent(Slot)) {
+			Source.Mesh = SlotMesh->SkeletalMesh;
+		}
+
+		if (Clothing) {
+			Source.OverrideMaterial = Clothing->MaterialInstance;
+		}
+
+		if (Source.Mesh) {
+			Sources.Add(Source);
+		}
+	}
+
+	MergeSubsystem->RequestMergedMesh(Sources, FOnClothingMeshMerged::CreateUObject(this, &ASurvivalCharacter::OnMergedMeshReady, MergedMeshRequestId));
+}
+
+void ASurvivalCharacter::OnMergedMeshReady(USkeletalMesh* MergedMesh, int32 RequestId)
+{
+	//equipment changed again while we were waiting
+	if (RequestId != MergedMeshRequestId || !IsAlive()) {
+		return;
+	}
+
+	SetMergedMesh(MergedMesh);
+}
+
+void ASurvivalCharacter::SetMergedMesh(USkeletalMesh* MergedMesh)
+{
+	if (MergedMesh) {
+		GetMesh()->SetSkeletalMesh(MergedMesh, false);
+		GetMesh()->EmptyOverrideMaterials();
+		bMergedMeshActive = true;
+	}
+	else if (bMergedMeshActive) {
+		//character mesh is the head slot too, put back whatever is worn there like EquipClothing does
+		if (UClothingItem* HeadClothing = Cast<UClothingItem>(EquippedItems.FindRef(EEquippableSlot::EIS_Head))) {
+			GetMesh()->SetSkeletalMesh(HeadClothing->Mesh, false);
+			GetMesh()->SetMaterial(GetMesh()->GetMaterials().Num() - 1, HeadClothing->MaterialInstance);
+		}
+		else {
+			GetMesh()->SetSkeletalMesh(NakedMeshes.FindRef(EEquippableSlot::EIS_Head), false);
+		}
+		bMergedMeshActive = false;
+	}
+	else {
+		return;
+	}
+
+	for (auto& PlayerMesh : PlayerMeshes) {
+		if (PlayerMesh.Value && PlayerMesh.Value != GetMesh()) {
+			PlayerMesh.Value->SetVisibility(!bMergedMeshActive);
+		}
+	}
 }
 
 void ASurvivalCharacter::EquipWeapon(class UWeaponItem* WeaponItem)
@@ -141,15 +255,30 @@ void ASurvivalCharacter::EquipWeapon(class UWeaponItem* WeaponItem)
 		if (EquippedWeapon)
 			UnEquipWeapon();
 
-		FActorSpawnParameters spawnparam;
-		spawnparam.bNoFail = true;
-		spawnparam.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
-		spawnparam.Owner = spawnparam.Instigator = this;
+		//reuse a weapon of the same class we unequipped before instead of spawning a new one
+		AWeapon* Weapon = nullptr;
+		for (int32 i = 0; i < PooledWeapons.Num(); ++i) {
+			if (PooledWeapons[i] && PooledWeapons[i]->GetClass() == WeaponItem->WeaponClass) {
+				Weapon = PooledWeapons[i];
+				PooledWeapons.RemoveAtSwap(i);
+				Weapon->ActivateFromPool();
+				break;
+			}
+		}
+
+		if (!Weapon) {
+			FActorSpawnParameters spawnparam;
+			spawnparam.bNoFail = true;
+			spawnparam.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+			spawnparam.Owner = spawnparam.Instigator = this;
 
-		if (AWeapon* Weapon = GetWorld()->SpawnActor<AWeapon>(WeaponItem->WeaponClass, spawnparam)) {
+			Weapon = GetWorld()->SpawnActor<AWeapon>(WeaponItem->WeaponClass, spawnparam);
+		}
+
+		if (Weapon) {
 			Weapon->Item = WeaponItem;
 			EquippedWeapon = Weapon;
-			OnRep_EquippedWeapon();
+			OnRep_EquippedWeapon(nullptr);
 
 			Weapon->OnEquip();
 		}
@@ -159,11 +288,18 @@ void ASurvivalCharacter::EquipWeapon(class UWeaponItem* WeaponItem)
 void ASurvivalCharacter::UnEquipWeapon()
 {
 	if (HasAuthority() && EquippedWeapon) {
-		EquippedWeapon->OnUnEquip();
-		EquippedWeapon->Destroy();
+		AWeapon* OldWeapon = EquippedWeapon;
+		OldWeapon->OnUnEquip();
 		EquippedWeapon = nullptr;
-		OnRep_EquippedWeapon();
 
+		if (PooledWeapons.Num() < MaxPooledWeapons) {
+			PooledWeapons.Add(OldWeapon);
+		}
+		else {
+			OldWeapon->Destroy();
+		}
+
+		OnRep_EquippedWeapon(OldWeapon);
 	}
 }
 
@@ -175,6 +311,57 @@ class USkeletalMeshComponent* ASurvivalCharacter::GetSlotSkeletalMeshComponent(c
 	return nullptr;
 }
 
+class USkeletalMeshComponent* ASurvivalCharacter::GetOrCreateSlotMeshComponent(const EEquippableSlot Slot)
+{
+	if (USkeletalMeshComponent* ExistingMesh = GetSlotSkeletalMeshComponent(Slot)) {
+		return ExistingMesh;
+	}
+
+	//body meshes are purely cosmetic, server does hit detection against the head mesh only
+	if (GetNetMode() == NM_DedicatedServer) {
+		return nullptr;
+	}
+
+	USkeletalMeshComponent* SlotMesh = nullptr;
+	switch (Slot) {
+	case EEquippableSlot::EIS_Helmet:
+		SlotMesh = HelmetMesh = NewObject<USkeletalMeshComponent>(this, TEXT("HelmetMesh"));
+		break;
+	case EEquippableSlot::EIS_Chest:
+		SlotMesh = ChestMesh = NewObject<USkeletalMeshComponent>(this, TEXT("ChestMesh"));
+		break;
+	case EEquippableSlot::EIS_Legs:
+		SlotMesh = LegsMesh = NewObject<USkeletalMeshComponent>(this, TEXT("LegsMesh"));
+		break;
+	case EEquippableSlot::EIS_Feet:
+		SlotMesh = FeetMesh = NewObject<USkeletalMeshComponent>(this, TEXT("FeetMesh"));
+		break;
+	case EEquippableSlot::EIS_Vest:
+		SlotMesh = VestMesh = NewObject<USkeletalMeshComponent>(this, TEXT("VestMesh"));
+		break;
+	case EEquippableSlot::EIS_Hands:
+		SlotMesh = HandsMesh = NewObject<USkeletalMeshComponent>(this, TEXT("HandsMesh"));
+		break;
+	case EEquippableSlot::EIS_Backpack:
+		SlotMesh = BackpackMesh = NewObject<USkeletalMeshComponent>(this, TEXT("BackpackMesh"));
+		break;
+	default:
+		//weapon and throwable slots don't have a body mesh
+		return nullptr;
+	}
+
+	//Tell the body mesh to use the head mesh for animation
+	SlotMesh->SetupAttachment(GetMesh());
+	SlotMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	SlotMesh->RegisterComponent();
+	SlotMesh->SetMasterPoseComponent(GetMesh());
+	SlotMesh->SetVisibility(!bMergedMeshActive);
+	ApplyMeshSignificance(SlotMesh);
+
+	PlayerMeshes.Add(Slot, SlotMesh);
+	return SlotMesh;
+}
+
 void ASurvivalCharacter::SetLootSource(class UInventoryComponent* NewLootSource)
 {
 	// remove dead body after 2min
@@ -187,7 +374,10 @@ void ASurvivalCharacter::SetLootSource(class UInventoryComponent* NewLootSource)
 	if (HasAuthority()) {
 		if (NewLootSource) {
 			//Looting a player keeps thir body alive for extra 2min to provide enough time to loot
-			if (ASurvivalCharacter* Character = Cast<ASurvivalCharacter>(NewLootSource->GetOwner())) {
+			if (UCorpseSubsystem* CorpseSubsystem = GetWorld()->GetSubsystem<UCorpseSubsystem>()) {
+				CorpseSubsystem->NotifyLooted(NewLootSource->GetOwner());
+			}
+			else if (ASurvivalCharacter* Character = Cast<ASurvivalCharacter>(NewLootSource->GetOwner())) {
 				Character->SetLifeSpan(120.f);
 			}
 		}
@@ -210,7 +400,13 @@ void ASurvivalCharacter::LootItem(class UItem* ItemToGive)
 			const FItemAddResult AddResult = PlayerInventory->TryAddItem(ItemToGive);
 
 			if (AddResult.ActualAmountGiven > 0) {
-				LootSource->ConsumeItem(ItemToGive, AddResult.ActualAmountGiven);
+				//seeded chests decide which of their stacks it comes from
+				if (ALootableChest* LootChest = Cast<ALootableChest>(LootSource->GetOwner())) {
+					LootChest->TakeItem(ItemToGive, AddResult.ActualAmountGiven);
+				}
+				else {
+					LootSource->ConsumeItem(ItemToGive, AddResult.ActualAmountGiven);
+				}
 			}
 			else {
 				if (ASurvivalPlayerController* PC = Cast<ASurvivalPlayerController>(GetController())) {
@@ -219,6 +415,11 @@ void ASurvivalCharacter::LootItem(class UItem* ItemToGive)
 			}
 		}
 	}
+	else if (LootSource && !LootSource->GetIsReplicated()) {
+		if (ItemToGive) {
+			ServerLootItemByClass(ItemToGive->GetClass());
+		}
+	}
 	else {
 		ServerLootItem(ItemToGive);
 	}
@@ -235,6 +436,18 @@ bool ASurvivalCharacter::ServerLootItem_Validate(class UItem* ItemToLoot)
 	return true;
 }
 
+void ASurvivalCharacter::ServerLootItemByClass_Implementation(TSubclassOf<class UItem> ItemClass)
+{
+	if (LootSource) {
+		LootItem(LootSource->FindItemByClass(ItemClass));
+	}
+}
+
+bool ASurvivalCharacter::ServerLootItemByClass_Validate(TSubclassOf<class UItem> ItemClass)
+{
+	return true;
+}
+
 void ASurvivalCharacter::BeginLootingPlayer(class ASurvivalCharacter* Character)
 {
 	if (Character) {
@@ -288,11 +501,17 @@ void ASurvivalCharacter::OnRep_Health(float OldHealth)
 	OnHealthModified(Health - OldHealth);
 }
 
-void ASurvivalCharacter::OnRep_EquippedWeapon()
+void ASurvivalCharacter::OnRep_EquippedWeapon(class AWeapon* OldWeapon)
 {
+	//unequipped weapons aren't destroyed anymore, they go back to the pool so hide them everywhere
+	if (IsValid(OldWeapon) && OldWeapon != EquippedWeapon) {
+		OldWeapon->DeactivateToPool();
+	}
+
 	if (EquippedWeapon) { //other client calls this
 		EquippedWeapon->OnEquip();
-	} //unequipping destorys so no need for that
+		ApplyWeaponSignificance();
+	}
 }
 
 void ASurvivalCharacter::StartFire()
@@ -315,9 +534,9 @@ void ASurvivalCharacter::StopFire()
 
 void ASurvivalCharacter::BeginMeleeAttack()
 {
-	if (GetWorld()->TimeSince(LastMeleeAttackTime) > MeleeAttackMontage->GetPlayLength()) { //limit punching interval to animation speed
+	USceneQuerySubsystem* SceneQuery = GetWorld()->GetSubsystem<USceneQuerySubsystem>();
+	if (SceneQuery && GetWorld()->TimeSince(LastLocalMeleeAttackTime) > MeleeAttackMontage->GetPlayLength()) { //limit punching interval to animation speed
 
-		FHitResult Hit;
 		FCollisionShape Shape = FCollisionShape::MakeSphere(15.f);
 		FVector StartTrace = PlayerCameraComponent->GetComponentLocation();
 		FVector EndTrace = (PlayerCameraComponent->GetComponentRotation().Vector() * MeleeAttackDistance) + StartTrace;
@@ -326,37 +545,53 @@ void ASurvivalCharacter::BeginMeleeAttack()
 
 		PlayAnimMontage(MeleeAttackMontage);
 
-		if (GetWorld()->SweepSingleByChannel(Hit, StartTrace, EndTrace, FQuat(), COLLISION_WEAPON, Shape, QueryParams)) {
-			UE_LOG(LogTemp, Warning, TEXT("We hit something with our punch"));
+		SceneQuery->QueueSweep(ESceneQueryCategory::Melee, StartTrace, EndTrace, Shape, COLLISION_WEAPON, QueryParams, FOnSceneQueryComplete::CreateUObject(this, &ASurvivalCharacter::OnMeleeSweepCompleted));
 
-			if (ASurvivalCharacter* HitPlayer = Cast<ASurvivalCharacter>(Hit.GetActor())) {
-				if (ASurvivalPlayerController* PC = Cast<ASurvivalPlayerController>(GetController())) {
-					PC->OnHitPlayer(); //display hitmarker or something
-				}
-			}
-		}
+		LastLocalMeleeAttackTime = GetWorld()->GetTimeSeconds();
+	}
+}
 
-		ServerProcessMeleeHit(Hit);
+void ASurvivalCharacter::OnMeleeSweepCompleted(const FSceneQueryResult& Result)
+{
+	if (Result.bBlockingHit) {
+		UE_LOG(LogTemp, Warning, TEXT("We hit something with our punch"));
 
-		LastMeleeAttackTime = GetWorld()->GetTimeSeconds();
+		if (ASurvivalCharacter* HitPlayer = Cast<ASurvivalCharacter>(Result.Hit.GetActor())) {
+			if (ASurvivalPlayerController* PC = Cast<ASurvivalPlayerController>(GetController())) {
+				PC->OnHitPlayer(); //display hitmarker or something
+			}
+		}
 	}
+
+	ServerProcessMeleeHit(Result.Hit);
 }
 
-void ASurvivalCharacter::MulticastPlayMeleeFX_Implementation()
+void ASurvivalCharacter::MulticastPlayMeleeFX_Implementation(const bool bHitSomething, const FVector_NetQuantize& ImpactPoint)
 {
-	if (!IsLocallyControlled()) {
+	NotifyCombatActivity();
+
+	if (!IsLocallyControlled() && ShouldPlayCosmeticFX()) {
 		PlayAnimMontage(MeleeAttackMontage);
 	}
+
+	if (bHitSomething) {
+		if (UCombatFXSubsystem* FXSubsystem = GetWorld()->GetSubsystem<UCombatFXSubsystem>()) {
+			FXSubsystem->SpawnFXAtLocation(MeleeImpactFX, ImpactPoint, (GetActorLocation() - ImpactPoint).Rotation(), this);
+		}
+	}
 }
 
 void ASurvivalCharacter::ServerProcessMeleeHit_Implementation(const FHitResult& MeleeHit) 
 {
-	MulticastPlayMeleeFX(); //play anim to all client
+	MulticastPlayMeleeFX(MeleeHit.bBlockingHit, MeleeHit.ImpactPoint); //play anim to all client
 
 	if (GetWorld()->TimeSince(LastMeleeAttackTime) > MeleeAttackMontage->GetPlayLength() //prevent hitting to fast
 		&& (GetActorLocation()- MeleeHit.ImpactPoint).Size() <= MeleeAttackDistance ) //prevents cheating distance
 	{ 
-		UGameplayStatics::ApplyPointDamage(MeleeHit.GetActor(), MeleeAttackDamage, (MeleeHit.TraceStart - MeleeHit.TraceEnd).GetSafeNormal(), MeleeHit, GetController(), this, UMeleeDamage::StaticClass());
+		if (UHitRegistrationSubsystem* HitRegistration = GetWorld()->GetSubsystem<UHitRegistrationSubsystem>()) {
+			const FPointDamageEvent DamageEvent(MeleeAttackDamage, MeleeHit, (MeleeHit.TraceStart - MeleeHit.TraceEnd).GetSafeNormal(), UMeleeDamage::StaticClass());
+			HitRegistration->QueuePointDamage(MeleeHit.GetActor(), MeleeAttackDamage, DamageEvent, GetController(), this);
+		}
 
 	}
 	LastMeleeAttackTime = GetWorld()->GetTimeSeconds();
@@ -377,7 +612,17 @@ void ASurvivalCharacter::KilledByPlayer(struct FDamageEvent const& DamageEvent,
 
 void ASurvivalCharacter::OnRep_Killer()
 {
-	SetLifeSpan(20.f); //dispose character after 20sec
+	//server hands the body to the corpse manager, which budgets ragdolls and converts the body to a loot proxy later
+	UCorpseSubsystem* CorpseSubsystem = GetWorld()->GetSubsystem<UCorpseSubsystem>();
+	if (HasAuthority() && CorpseSubsystem) {
+		CorpseSubsystem->RegisterCorpse(this);
+	}
+	else {
+		SetLifeSpan(20.f); //dispose character after 20sec
+	}
+
+	//ragdoll uses per slot meshes, swap back before physics starts
+	SetMergedMesh(nullptr);
 	 
 	//ragdoll
 	GetMesh()->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
@@ -420,7 +665,7 @@ void ASurvivalCharacter::ServerUseThrowable_Implementation()
 void ASurvivalCharacter::MulticastPlayThrowableTossFX_Implementation(UAnimMontage* ThrowMontage)
 {
 	//Server doesn't need FX and local machine we instantly played animation
-	if (GetNetMode() != NM_DedicatedServer && !IsLocallyControlled()) {
+	if (GetNetMode() != NM_DedicatedServer && !IsLocallyControlled() && ShouldPlayCosmeticFX()) {
 		PlayAnimMontage(ThrowMontage);
 	}
 }
@@ -487,6 +732,41 @@ bool ASurvivalCharacter::CanUseThrowable() const
 	return GetThrowable() != nullptr && GetThrowable()->ThrowableClass != nullptr;
 }
 
+void ASurvivalCharacter::PostLoad()
+{
+	Super::PostLoad();
+
+	//blueprints saved while the slot meshes were default subobjects set their naked meshes on those components.
+	//the components still load under their old names, so move their meshes over to NakedMeshes
+	static const TPair<EEquippableSlot, const TCHAR*> LegacySlotMeshNames[] = {
+		{ EEquippableSlot::EIS_Helmet, TEXT("HelmetMesh") },
+		{ EEquippableSlot::EIS_Chest, TEXT("ChestMesh") },
+		{ EEquippableSlot::EIS_Legs, TEXT("LegsMesh") },
+		{ EEquippableSlot::EIS_Feet, TEXT("FeetMesh") },
+		{ EEquippableSlot::EIS_Vest, TEXT("VestMesh") },
+		{ EEquippableSlot::EIS_Hands, TEXT("HandsMesh") },
+		{ EEquippableSlot::EIS_Backpack, TEXT("BackpackMesh") }
+	};
+
+	bool bMigrated = false;
+	for (const TPair<EEquippableSlot, const TCHAR*>& LegacySlotMesh : LegacySlotMeshNames) {
+		if (!NakedMeshes.Contains(LegacySlotMesh.Key)) {
+			const USkeletalMeshComponent* LegacyComponent = FindObjectFast<USkeletalMeshComponent>(this, LegacySlotMesh.Value);
+			if (LegacyComponent && LegacyComponent->SkeletalMesh) {
+				NakedMeshes.Add(LegacySlotMesh.Key, LegacyComponent->SkeletalMesh);
+				bMigrated = true;
+			}
+		}
+	}
+
+#if WITH_EDITOR
+	//resave to keep the migrated meshes once the old components are gone
+	if (bMigrated) {
+		MarkPackageDirty();
+	}
+#endif
+}
+
 // Called when the game starts or when spawned
 void ASurvivalCharacter::BeginPlay()
 {
@@ -498,11 +778,41 @@ void ASurvivalCharacter::BeginPlay()
 		LootPlayerInteraction->SetInteractableNameText(FText::FromString(PS->GetPlayerName()));
 	}
 
-	//When the player spawns in they have no items equipped, so cache these items(that way, if a player unequips an item we can set the mesh back to naked
-	for (auto& PlayerMesh : PlayerMeshes) {
-		NakedMeshes.Add(PlayerMesh.Key, PlayerMesh.Value->SkeletalMesh);
+	//When the player spawns in they have no items equipped, so dress the slots that have a naked mesh(that way, if a player unequips an item we can set the mesh back to naked
+	if (!NakedMeshes.Contains(EEquippableSlot::EIS_Head)) {
+		NakedMeshes.Add(EEquippableSlot::EIS_Head, GetMesh()->SkeletalMesh);
+	}
+
+	for (auto& NakedMesh : NakedMeshes) {
+		//slots that already got clothing replicated before we began play keep it
+		if (NakedMesh.Value && !GetSlotSkeletalMeshComponent(NakedMesh.Key)) {
+			if (USkeletalMeshComponent* SlotMesh = GetOrCreateSlotMeshComponent(NakedMesh.Key)) {
+				SlotMesh->SetSkeletalMesh(NakedMesh.Value);
+			}
+		}
+	}
+
+	if (UCharacterSignificanceSubsystem* SignificanceSubsystem = GetWorld()->GetSubsystem<UCharacterSignificanceSubsystem>()) {
+		SignificanceSubsystem->RegisterCharacter(this);
 	}
-	
+}
+
+void ASurvivalCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UCharacterSignificanceSubsystem* SignificanceSubsystem = GetWorld()->GetSubsystem<UCharacterSignificanceSubsystem>()) {
+		SignificanceSubsystem->UnregisterCharacter(this);
+	}
+
+	if (HasAuthority()) {
+		for (AWeapon* PooledWeapon : PooledWeapons) {
+			if (PooledWeapon) {
+				PooledWeapon->Destroy();
+			}
+		}
+		PooledWeapons.Empty();
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void ASurvivalCharacter::Restart()
@@ -516,12 +826,19 @@ void ASurvivalCharacter::Restart()
 
 float ASurvivalCharacter::TakeDamage(float Damage, struct FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser)
 {
+	//dead bodies still get shot, but they can't die again
+	if (!IsAlive()) {
+		return 0.f;
+	}
+
 	Super::TakeDamage(Damage, DamageEvent, EventInstigator, DamageCauser);
 
+	NotifyCombatActivity();
+
 	const float DamageDealt = ModifyHealth(-Damage);
 
 	if (Health <= 0.f) {
-		if (ASurvivalCharacter* dmgkiller = Cast<ASurvivalCharacter>(DamageCauser->GetOwner())) {
+		if (ASurvivalCharacter* dmgkiller = DamageCauser ? Cast<ASurvivalCharacter>(DamageCauser->GetOwner()) : nullptr) {
 			KilledByPlayer(DamageEvent, dmgkiller, DamageCauser);
 		}
 		else {
@@ -821,24 +1138,44 @@ void ASurvivalCharacter::DropItem(class UItem* Item, const int32 Quantity)
 			return;
 		} else{
 			//server
-			const int32 ItemQuantity = Item->GetQuantity();
-			const int32 DroppedQuantity = PlayerInventory->ConsumeItem(Item, Quantity);
-
-			//spawn pickup
-			FActorSpawnParameters SpawnParams;
-			SpawnParams.Owner = this;
-			SpawnParams.bNoFail = true; //always spawn
-			SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn; // prevents item stuck in wall or smt like that
-
 			FVector SpawnLocation = GetActorLocation();
 			SpawnLocation.Z -= GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
 
-			FTransform SpawnTransform(GetActorRotation(), SpawnLocation);
+			int32 QuantityToDrop = FMath::Min(Quantity, Item->GetQuantity());
+
+			//fill up stacks of the same item lying here before spawning another pickup, and refuse what needs a new pickup if this spot is full
+			UPickupDropSubsystem* DropSubsystem = GetWorld()->GetSubsystem<UPickupDropSubsystem>();
+			if (DropSubsystem) {
+				const int32 MergeSpace = DropSubsystem->GetMergeSpace(Item->GetClass(), SpawnLocation, QuantityToDrop);
+				if (MergeSpace < QuantityToDrop && !DropSubsystem->CanSpawnPickupAt(SpawnLocation)) {
+					QuantityToDrop = MergeSpace;
+					if (ASurvivalPlayerController* PC = Cast<ASurvivalPlayerController>(GetController())) {
+						PC->ClientShowNotification(LOCTEXT("DropAreaFullText", "There are too many items on the ground here."));
+					}
+				}
+			}
+
+			if (QuantityToDrop <= 0) {
+				return;
+			}
+
+			const int32 DroppedQuantity = PlayerInventory->ConsumeItem(Item, QuantityToDrop);
+			const int32 MergedQuantity = DropSubsystem ? DropSubsystem->MergeIntoNearbyPickups(Item->GetClass(), SpawnLocation, DroppedQuantity) : 0;
+
+			if (DroppedQuantity > MergedQuantity) {
+				//spawn pickup
+				FActorSpawnParameters SpawnParams;
+				SpawnParams.Owner = this;
+				SpawnParams.bNoFail = true; //always spawn
+				SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn; // prevents item stuck in wall or smt like that
+
+				FTransform SpawnTransform(GetActorRotation(), SpawnLocation);
 
-			ensure(PickupClass);
+				ensure(PickupClass);
 
-			APickup* Pickup = GetWorld()->SpawnActor<APickup>(PickupClass, SpawnTransform, SpawnParams);
-			Pickup->InitializePickup(Item->GetClass(), DroppedQuantity);
+				APickup* Pickup = GetWorld()->SpawnActor<APickup>(PickupClass, SpawnTransform, SpawnParams);
+				Pickup->InitializePickup(Item->GetClass(), DroppedQuantity - MergedQuantity);
+			}
 		}
 	}
 }
@@ -863,7 +1200,7 @@ void ASurvivalCharacter::Tick(float DeltaTime)
 
 	//optimization : perform trace check by given frequency, not every frame
 	if ((!HasAuthority() || bIsInteractingOnServer) && GetWorld()->TimeSince(InteractionData.LastInteractionCheckTime) > InteractionCheckFrequency) {
-		PerformInteractionCheck();
+		QueueInteractionCheck();
 	}
 
 	if (IsLocallyControlled()) {
@@ -902,12 +1239,48 @@ void ASurvivalCharacter::PerformInteractionCheck()
 	FCollisionQueryParams QueryParams;
 	QueryParams.AddIgnoredActor(this); //ignore colliding with character itself
 
-	if (GetWorld()->LineTraceSingleByChannel(TraceHit, TraceStart, TraceEnd, ECC_Visibility, QueryParams)) {
+	const bool bHit = GetWorld()->LineTraceSingleByChannel(TraceHit, TraceStart, TraceEnd, ECC_Visibility, QueryParams);
+	ProcessInteractionCheck(bHit, TraceHit);
+}
+
+void ASurvivalCharacter::QueueInteractionCheck()
+{
+	USceneQuerySubsystem* SceneQuery = GetWorld()->GetSubsystem<USceneQuerySubsystem>();
+	if (GetController() == nullptr || SceneQuery == nullptr) {
+		return;
+	}
+
+	InteractionData.LastInteractionCheckTime = GetWorld()->GetTimeSeconds();
+
+	FVector EyesLocation;
+	FRotator EyesRotation;
+	GetController()->GetPlayerViewPoint(EyesLocation, EyesRotation);
+
+	FVector TraceStart = EyesLocation;
+	FVector TraceEnd = (EyesRotation.Vector() * InteractionCheckDistance) + TraceStart;
+
+	FCollisionQueryParams QueryParams;
+	QueryParams.AddIgnoredActor(this); //ignore colliding with character itself
+
+	SceneQuery->QueueLineTrace(ESceneQueryCategory::Interaction, TraceStart, TraceEnd, ECC_Visibility, QueryParams, FOnSceneQueryComplete::CreateUObject(this, &ASurvivalCharacter::OnInteractionCheckCompleted));
+}
+
+void ASurvivalCharacter::OnInteractionCheckCompleted(const FSceneQueryResult& Result)
+{
+	//interaction may have started or controller gone while the trace was in flight
+	if (GetController()) {
+		ProcessInteractionCheck(Result.bBlockingHit, Result.Hit);
+	}
+}
+
+void ASurvivalCharacter::ProcessInteractionCheck(const bool bHit, const FHitResult& TraceHit)
+{
+	if (bHit) {
 		if (TraceHit.GetActor()) {
 			//check if hit actor has interaction component
 			if (UInteractionComponent* InteractionComponent = Cast<UInteractionComponent>(TraceHit.GetActor()->GetComponentByClass(UInteractionComponent::StaticClass()))) {
 
-				float Distance = (TraceStart - TraceHit.ImpactPoint).Size();
+				float Distance = (TraceHit.TraceStart - TraceHit.ImpactPoint).Size();
 
 				//check if it is interactable we're already looking
 				if (InteractionComponent != GetInteractable() && Distance <= InteractionComponent->InteractionDistance) {
@@ -957,4 +1330,69 @@ void ASurvivalCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputC
 
 }
 
+void ASurvivalCharacter::SetSignificance(const ECharacterSignificance NewSignificance)
+{
+	if (Significance == NewSignificance) {
+		return;
+	}
+
+	Significance = NewSignificance;
+
+	const float* TickInterval = SignificanceTickIntervals.Find(Significance);
+	const float NewTickInterval = TickInterval ? *TickInterval : 0.f;
+	SetActorTickInterval(NewTickInterval);
+
+	//only the head mesh runs animation, the rest follow it as master pose, but all of them skin and update bounds
+	for (auto& PlayerMesh : PlayerMeshes) {
+		if (USkeletalMeshComponent* MeshComponent = PlayerMesh.Value) {
+			ApplyMeshSignificance(MeshComponent);
+		}
+	}
+
+	ApplyWeaponSignificance();
+}
+
+void ASurvivalCharacter::ApplyMeshSignificance(class USkeletalMeshComponent* MeshComponent)
+{
+	const float* TickInterval = SignificanceTickIntervals.Find(Significance);
+	const bool bHighSignificance = Significance == ECharacterSignificance::CS_High;
+
+	MeshComponent->bEnableUpdateRateOptimizations = !bHighSignificance;
+	MeshComponent->SetComponentTickInterval(TickInterval ? *TickInterval : 0.f);
+
+	if (bHighSignificance) {
+		MeshComponent->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::AlwaysTickPoseAndRefreshBones;
+	}
+	else if (Significance == ECharacterSignificance::CS_Culled) {
+		//montages still need to tick so notifies fire, but pose is only evaluated if we actually see it
+		MeshComponent->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickMontagesWhenNotRendered;
+	}
+	else {
+		MeshComponent->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered;
+	}
+}
+
+bool ASurvivalCharacter::ShouldPlayCosmeticFX() const
+{
+	return Significance <= ECharacterSignificance::CS_Medium;
+}
+
+bool ASurvivalCharacter::ShouldPlayCosmeticAudio() const
+{
+	return Significance != ECharacterSignificance::CS_Culled;
+}
+
+void ASurvivalCharacter::NotifyCombatActivity()
+{
+	LastCombatActivityTime = GetWorld()->GetTimeSeconds();
+}
+
+void ASurvivalCharacter::ApplyWeaponSignificance()
+{
+	//local weapon always ticks, remote ones only need it when somebody might see it
+	if (EquippedWeapon) {
+		EquippedWeapon->SetActorTickEnabled(IsLocallyControlled() || Significance <= ECharacterSignificance::CS_Medium);
+	}
+}
+
 #undef LOCTEXT_NAMESPACE
\ No newline at end of file
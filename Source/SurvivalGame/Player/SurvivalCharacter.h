@@ -4,8 +4,11 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "Player/CharacterSignificanceSubsystem.h"
 #include "SurvivalCharacter.generated.h"
 
+struct FSceneQueryResult;
+
 USTRUCT()
 struct FinteractionData {
 	GENERATED_BODY()
@@ -39,17 +42,21 @@ public:
 	// Sets default values for this character's properties
 	ASurvivalCharacter();
 
-	//The mesh to have equippped if we don't have an item equipped - ie the bare skin meshes
-	UPROPERTY(BlueprintReadOnly, Category="Mesh")
+	//The mesh to have equippped if we don't have an item equipped - ie the bare skin meshes. Head defaults to the character mesh
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="Mesh")
 	TMap<EEquippableSlot, USkeletalMesh*> NakedMeshes;
 
-	//The player's body meshes
+	//The player's body meshes. Slot components are only created once something occupies the slot, and never on dedicated server
 	UPROPERTY(BlueprintReadOnly, Category="Mesh")
 	TMap<EEquippableSlot, USkeletalMeshComponent*> PlayerMeshes;
 
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Components")
 	class UInventoryComponent* PlayerInventory;
 
+	/** Pooled audio components for weapon and character sounds */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Components")
+	class UAudioPoolComponent* AudioPool;
+
 	/** Interaction component used to allow other players to loot us when we died */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Components")
 	class UInteractionComponent* LootPlayerInteraction;
@@ -60,19 +67,19 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Components")
 	class UCameraComponent* PlayerCameraComponent;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Components")
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Components")
 	class USkeletalMeshComponent* HelmetMesh;
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Components")
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Components")
 	class USkeletalMeshComponent* ChestMesh;
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Components")
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Components")
 	class USkeletalMeshComponent* LegsMesh;
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Components")
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Components")
 	class USkeletalMeshComponent* FeetMesh;
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Components")
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Components")
 	class USkeletalMeshComponent* VestMesh;
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Components")
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Components")
 	class USkeletalMeshComponent* HandsMesh;
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Components")
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Components")
 	class USkeletalMeshComponent* BackpackMesh;
 
 	// Called every frame
@@ -84,7 +91,9 @@ public:
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void Restart() override;
+	virtual void PostLoad() override;
 
 	virtual float TakeDamage(float Damage, struct FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser) override;
 
@@ -161,8 +170,17 @@ protected:
 	UPROPERTY(EditDefaultsOnly,Category="Interaction")
 	float InteractionCheckDistance;
 
+	/** Trace for an interactable right away. Server uses this when interaction begins, since it doesn't check every tick */
 	void PerformInteractionCheck();
 
+	/** Queue the periodic interaction trace with the scene query service */
+	void QueueInteractionCheck();
+
+	void OnInteractionCheckCompleted(const FSceneQueryResult& Result);
+
+	/** Update viewed interactable from an interaction trace */
+	void ProcessInteractionCheck(const bool bHit, const FHitResult& TraceHit);
+
 	void CouldntFindInteractable();
 	void FoundNewInteractable(UInteractionComponent* Interactable);
 
@@ -223,9 +241,45 @@ public:
 	UPROPERTY(BlueprintAssignable, Category="Items")
 	FOnEquipppedItemsChanged OnEquipppedItemsChanged;
 
+	/** Get the mesh component of the slot. Null if nothing ever occupied the slot */
 	UFUNCTION(BlueprintPure)
 	class USkeletalMeshComponent* GetSlotSkeletalMeshComponent(const EEquippableSlot Slot);
 
+protected:
+	/** Get the mesh component of the slot, creating it the first time the slot is occupied. Always null on dedicated server */
+	class USkeletalMeshComponent* GetOrCreateSlotMeshComponent(const EEquippableSlot Slot);
+
+public:
+
+	/**
+	 * Merge all body slot meshes into a single skeletal mesh on remote characters. Saves skinning and component updates of 7 meshes per character.
+	 * Per slot meshes are displayed while merge is being rebuilt after equipment changes.
+	 */
+	UPROPERTY(EditDefaultsOnly, Category = "Mesh")
+	bool bMergeClothingMeshes;
+
+protected:
+	/** Is the merged mesh currently displayed instead of per slot meshes */
+	bool bMergedMeshActive;
+
+	/** Is a merged mesh rebuild queued for next tick */
+	bool bMergedMeshRebuildQueued;
+
+	/** Incremented every rebuild so late merge results for an old loadout are ignored */
+	int32 MergedMeshRequestId;
+
+	/** Fall back to per slot meshes and queue a rebuild of merged mesh for current equipment */
+	void RefreshMergedMesh();
+
+	void RequestMergedMesh();
+
+	void OnMergedMeshReady(USkeletalMesh* MergedMesh, int32 RequestId);
+
+	/** Display merged mesh on the character mesh and hide slot meshes. Null restores per slot meshes */
+	void SetMergedMesh(USkeletalMesh* MergedMesh);
+
+public:
+
 	UFUNCTION(BlueprintPure)
 	FORCEINLINE TMap<EEquippableSlot, UEquippableItem*> GetEquippedItems() const {return EquippedItems;}
 
@@ -238,12 +292,18 @@ public:
 	UFUNCTION(BlueprintPure, Category="Looting")
 	bool IsLooting() const;
 
+	FORCEINLINE class UInventoryComponent* GetLootSource() const { return LootSource; }
+
 	UFUNCTION(BlueprintCallable, Category = "Looting")
 	void LootItem(class UItem* ItemToGive);
 
 	UFUNCTION(Server, Reliable, WithValidation)
 	void ServerLootItem(class UItem* ItemToLoot);
 
+	/** Items of a loot source that doesn't replicate only exist on this client, so the server is told the class to loot instead */
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerLootItemByClass(TSubclassOf<class UItem> ItemClass);
+
 protected:
 	// Begin being looted by a player
 	UFUNCTION()
@@ -283,22 +343,36 @@ protected:
 	class AWeapon* EquippedWeapon;
 
 	UFUNCTION()
-	void OnRep_EquippedWeapon();
+	void OnRep_EquippedWeapon(class AWeapon* OldWeapon);
+
+	/** [server] Unequipped weapons kept hidden and dormant so equipping the same weapon class again doesn't spawn a new actor */
+	UPROPERTY(Transient)
+	TArray<class AWeapon*> PooledWeapons;
+
+	/** Max number of unequipped weapons kept in the pool. Extra weapons are destroyed on unequip */
+	UPROPERTY(EditDefaultsOnly, Category = "Weapons")
+	int32 MaxPooledWeapons;
 
 	void StartFire();
 	void StopFire();
 
 	void BeginMeleeAttack();
 
+	void OnMeleeSweepCompleted(const FSceneQueryResult& Result);
+
 	UFUNCTION(Server, Reliable)
 	void ServerProcessMeleeHit(const FHitResult& MeleeHit);
 
 	UFUNCTION(NetMulticast, Unreliable)
-	void MulticastPlayMeleeFX();
+	void MulticastPlayMeleeFX(const bool bHitSomething, const FVector_NetQuantize& ImpactPoint);
 
 	UPROPERTY()
 	float LastMeleeAttackTime;
 
+	/** when the local player last started a punch. Kept apart from LastMeleeAttackTime, which the server checks when the sweep result arrives */
+	UPROPERTY()
+	float LastLocalMeleeAttackTime;
+
 	UPROPERTY(EditDefaultsOnly, Category="Melee")
 	float MeleeAttackDistance;
 
@@ -309,6 +383,10 @@ protected:
 	UPROPERTY(EditDefaultsOnly, Category="Melee")
 	class UAnimMontage* MeleeAttackMontage;
 
+	/** FX played where our punches land */
+	UPROPERTY(EditDefaultsOnly, Category="Melee")
+	class UParticleSystem* MeleeImpactFX;
+
 	//Called when killed by the player, or killed by something else like the environment
 	void Suicide(struct FDamageEvent const& DamageEvent, const AActor* DamageCauser);
 	void KilledByPlayer(struct FDamageEvent const& DamageEvent, ASurvivalCharacter* Character, const AActor* DamageCauser);
@@ -334,6 +412,38 @@ protected:
 	void UseThrowable();
 	void SpawnThrowable();
 	bool CanUseThrowable() const;
-};
 
+public:
+	/** [local] Set by the significance subsystem. Scales tick rate, animation updates, weapon tick and cosmetics of this character */
+	void SetSignificance(const ECharacterSignificance NewSignificance);
+
+	UFUNCTION(BlueprintPure, Category = "Significance")
+	FORCEINLINE ECharacterSignificance GetSignificance() const { return Significance; }
+
+	/** Should particles and third person montages be played for this character on this machine */
+	bool ShouldPlayCosmeticFX() const;
+
+	/** Should sounds be played for this character on this machine */
+	bool ShouldPlayCosmeticAudio() const;
 
+	/** Called when character fires, punches or gets damaged. Characters in combat are more significant */
+	void NotifyCombatActivity();
+
+	FORCEINLINE float GetLastCombatActivityTime() const { return LastCombatActivityTime; }
+
+protected:
+	/** Actor and mesh tick interval for each significance level. Missing level means tick every frame */
+	UPROPERTY(EditDefaultsOnly, Category = "Significance")
+	TMap<ECharacterSignificance, float> SignificanceTickIntervals;
+
+	UPROPERTY(Transient)
+	ECharacterSignificance Significance;
+
+	float LastCombatActivityTime;
+
+	/** Push current significance to weapon tick */
+	void ApplyWeaponSignificance();
+
+	/** Push current significance to a body mesh's tick and animation settings */
+	void ApplyMeshSignificance(class USkeletalMeshComponent* MeshComponent);
+};
@@ -0,0 +1,239 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Weapons/CombatFXSubsystem.h"
+#include "Player/SurvivalCharacter.h"
+#include "GameFramework/PlayerController.h"
+#include "Particles/ParticleSystem.h"
+#include "Particles/ParticleSystemComponent.h"
+#include "Components/AudioComponent.h"
+#include "Engine/World.h"
+
+static FAutoConsoleCommandWithWorld CombatFXStatsCommand(
+	TEXT("Survival.CombatFXStats"),
+	TEXT("Print combat FX pool created/reused/culled counters"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (UCombatFXSubsystem* FXSubsystem = World ? World->GetSubsystem<UCombatFXSubsystem>() : nullptr) {
+			const FCombatFXStats& Stats = FXSubsystem->GetStats();
+			UE_LOG(LogTemp, Log, TEXT("Combat FX pool: %d created, %d reused, %d culled"), Stats.Created, Stats.Reused, Stats.Culled);
+			UE_LOG(LogTemp, Log, TEXT("Combat audio pool: %d created, %d reused, %d stolen, %d culled"), Stats.AudioCreated, Stats.AudioReused, Stats.AudioStolen, Stats.AudioCulled);
+		}
+	}));
+
+UCombatFXSubsystem::UCombatFXSubsystem()
+{
+	MaxSpawnsPerFrame = 16;
+	MaxFXDistance = 10000.f; //100 meter
+	MaxComponentsPerTemplate = 32;
+
+	ConcurrencyGroupLimits.Add(TEXT("Gunshot"), 8);
+	MaxVoiceDistance = 15000.f;
+	LocalVoicePriorityScale = 4.f;
+
+	SpawnsThisFrame = 0;
+	LocalViewLocation = FVector::ZeroVector;
+	bHasLocalView = false;
+}
+
+bool UCombatFXSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	if (!Super::ShouldCreateSubsystem(Outer)) {
+		return false;
+	}
+
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld() && !IsRunningDedicatedServer();
+}
+
+void UCombatFXSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	SpawnsThisFrame = 0;
+
+	//cache the view once a frame instead of looking for the local player on every spawn
+	bHasLocalView = false;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It) {
+		if (APlayerController* PC = It->Get()) {
+			if (PC->IsLocalController()) {
+				FRotator ViewRotation;
+				PC->GetPlayerViewPoint(LocalViewLocation, ViewRotation);
+				bHasLocalView = true;
+				break;
+			}
+		}
+	}
+}
+
+TStatId UCombatFXSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCombatFXSubsystem, STATGROUP_Tickables);
+}
+
+UParticleSystemComponent* UCombatFXSubsystem::SpawnFXAttached(UParticleSystem* Template, USceneComponent* AttachTo, const FName& AttachPointName, const ASurvivalCharacter* Instigator)
+{
+	if (!Template || !AttachTo || !ShouldSpawnFX(AttachTo->GetSocketLocation(AttachPointName), Instigator)) {
+		return nullptr;
+	}
+
+	UParticleSystemComponent* PSC = AcquireComponent(Template);
+	if (PSC) {
+		PSC->AttachToComponent(AttachTo, FAttachmentTransformRules::SnapToTargetNotIncludingScale, AttachPointName);
+		PSC->SetRelativeTransform(FTransform::Identity);
+		PSC->ActivateSystem(true);
+	}
+	return PSC;
+}
+
+UParticleSystemComponent* UCombatFXSubsystem::SpawnFXAtLocation(UParticleSystem* Template, const FVector& Location, const FRotator& Rotation, const ASurvivalCharacter* Instigator)
+{
+	if (!Template || !ShouldSpawnFX(Location, Instigator)) {
+		return nullptr;
+	}
+
+	UParticleSystemComponent* PSC = AcquireComponent(Template);
+	if (PSC) {
+		PSC->SetWorldLocationAndRotation(Location, Rotation);
+		PSC->ActivateSystem(true);
+	}
+	return PSC;
+}
+
+bool UCombatFXSubsystem::ShouldSpawnFX(const FVector& Location, const ASurvivalCharacter* Instigator)
+{
+	//our own shots always show up, budget is for everyone else
+	if (Instigator && Instigator->IsLocallyControlled()) {
+		return true;
+	}
+
+	if ((Instigator && !Instigator->ShouldPlayCosmeticFX())
+		|| (bHasLocalView && FVector::DistSquared(Location, LocalViewLocation) > FMath::Square(MaxFXDistance))
+		|| SpawnsThisFrame >= MaxSpawnsPerFrame) {
+		++Stats.Culled;
+		return false;
+	}
+
+	++SpawnsThisFrame;
+	return true;
+}
+
+UParticleSystemComponent* UCombatFXSubsystem::AcquireComponent(UParticleSystem* Template)
+{
+	FTemplatePool& Pool = Pools.FindOrAdd(Template);
+
+	while (Pool.FreeComponents.Num() > 0) {
+		UParticleSystemComponent* PSC = Pool.FreeComponents.Pop(false);
+		if (PSC && !PSC->IsPendingKill()) {
+			++Stats.Reused;
+			return PSC;
+		}
+		--Pool.NumComponents;
+	}
+
+	if (Pool.NumComponents >= MaxComponentsPerTemplate) {
+		++Stats.Culled;
+		return nullptr;
+	}
+
+	UParticleSystemComponent* PSC = NewObject<UParticleSystemComponent>(GetWorld());
+	PSC->bAutoActivate = false;
+	PSC->bAutoDestroy = false;
+	PSC->SecondsBeforeInactive = 0.f;
+	PSC->SetTemplate(Template);
+	PSC->OnSystemFinished.AddDynamic(this, &UCombatFXSubsystem::OnFXFinished);
+	PSC->RegisterComponentWithWorld(GetWorld());
+
+	PooledComponents.Add(PSC);
+	++Pool.NumComponents;
+	++Stats.Created;
+	return PSC;
+}
+
+bool UCombatFXSubsystem::CanPlayVoice(const FName& ConcurrencyGroup, const FVector& Location, const float Priority, const ASurvivalCharacter* Instigator)
+{
+	const int32* GroupLimit = ConcurrencyGroupLimits.Find(ConcurrencyGroup);
+	if (!GroupLimit) {
+		return true;
+	}
+
+	TArray<FActiveVoice>& Voices = ActiveVoices.FindOrAdd(ConcurrencyGroup);
+	Voices.RemoveAllSwap([](const FActiveVoice& Voice) {
+		return !Voice.AudioComponent.IsValid() || Voice.AudioComponent->Sound != Voice.Sound || !Voice.AudioComponent->IsPlaying();
+	});
+
+	if (Voices.Num() < *GroupLimit) {
+		return true;
+	}
+
+	int32 WeakestIndex = INDEX_NONE;
+	for (int32 i = 0; i < Voices.Num(); ++i) {
+		if (WeakestIndex == INDEX_NONE || Voices[i].Importance < Voices[WeakestIndex].Importance) {
+			WeakestIndex = i;
+		}
+	}
+
+	if (WeakestIndex != INDEX_NONE && Voices[WeakestIndex].Importance < GetVoiceImportance(Location, Priority, Instigator)) {
+		Voices[WeakestIndex].AudioComponent->Stop();
+		Voices.RemoveAtSwap(WeakestIndex);
+		++Stats.AudioStolen;
+		return true;
+	}
+
+	++Stats.AudioCulled;
+	return false;
+}
+
+void UCombatFXSubsystem::AddVoice(const FName& ConcurrencyGroup, UAudioComponent* AudioComponent, const FVector& Location, const float Priority, const ASurvivalCharacter* Instigator)
+{
+	if (!AudioComponent) {
+		return;
+	}
+
+	//pooled component that got stolen and played again still has its old voice, it only counts once
+	for (auto& GroupVoices : ActiveVoices) {
+		GroupVoices.Value.RemoveAllSwap([AudioComponent](const FActiveVoice& Voice) { return Voice.AudioComponent.Get() == AudioComponent; });
+	}
+
+	if (ConcurrencyGroupLimits.Contains(ConcurrencyGroup)) {
+		FActiveVoice& Voice = ActiveVoices.FindOrAdd(ConcurrencyGroup).AddDefaulted_GetRef();
+		Voice.AudioComponent = AudioComponent;
+		Voice.Sound = AudioComponent->Sound;
+		Voice.Importance = GetVoiceImportance(Location, Priority, Instigator);
+	}
+}
+
+void UCombatFXSubsystem::NotifyAudioComponentAcquired(const bool bCreated)
+{
+	if (bCreated) {
+		++Stats.AudioCreated;
+	}
+	else {
+		++Stats.AudioReused;
+	}
+}
+
+float UCombatFXSubsystem::GetVoiceImportance(const FVector& Location, const float Priority, const ASurvivalCharacter* Instigator) const
+{
+	//small floor so priority still matters for sounds at the edge of hearing
+	float DistanceScale = 1.f;
+	if (bHasLocalView) {
+		DistanceScale = FMath::Max(1.f - FVector::Dist(Location, LocalViewLocation) / MaxVoiceDistance, 0.05f);
+	}
+
+	const float LocalScale = Instigator && Instigator->IsLocallyControlled() ? LocalVoicePriorityScale : 1.f;
+	return Priority * DistanceScale * LocalScale;
+}
+
+void UCombatFXSubsystem::OnFXFinished(UParticleSystemComponent* FinishedComponent)
+{
+	if (!FinishedComponent) {
+		return;
+	}
+
+	//attached FX would follow a pooled weapon or dead body around, detach before going idle
+	FinishedComponent->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+
+	if (FTemplatePool* Pool = Pools.Find(FinishedComponent->Template)) {
+		Pool->FreeComponents.AddUnique(FinishedComponent);
+	}
+}
@@ -0,0 +1,134 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CombatFXSubsystem.generated.h"
+
+class ASurvivalCharacter;
+class UParticleSystem;
+class UParticleSystemComponent;
+class UAudioComponent;
+class USoundBase;
+
+/** Pool usage counters, useful to check that sustained fire isn't allocating anymore */
+struct FCombatFXStats {
+	/** components created because the pool of the template was empty */
+	int32 Created = 0;
+	/** spawns served by an idle pooled component */
+	int32 Reused = 0;
+	/** spawns skipped by distance, significance, frame budget or pool cap */
+	int32 Culled = 0;
+
+	/** audio components created by character audio pools */
+	int32 AudioCreated = 0;
+	/** sounds played on an already existing pooled audio component */
+	int32 AudioReused = 0;
+	/** playing voices stopped to make room for a more important sound of the same concurrency group */
+	int32 AudioStolen = 0;
+	/** sounds rejected because their concurrency group was full of more important voices */
+	int32 AudioCulled = 0;
+};
+
+/**
+ * Pools particle system components for combat FX (muzzle flashes, impacts, melee hits) so firing doesn't allocate and register a new component per shot.
+ * Spawns from remote characters are culled by their significance and distance to the local view, and limited by a per frame budget.
+ * Only created on machines that render (never on dedicated servers).
+ */
+UCLASS(Config = Game)
+class SURVIVALGAME_API UCombatFXSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UCombatFXSubsystem();
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Play FX attached to a component, ie muzzle flash. Return null if the FX was culled */
+	UParticleSystemComponent* SpawnFXAttached(UParticleSystem* Template, USceneComponent* AttachTo, const FName& AttachPointName, const ASurvivalCharacter* Instigator);
+
+	/** Play FX at a world location, ie bullet impact. Return null if the FX was culled */
+	UParticleSystemComponent* SpawnFXAtLocation(UParticleSystem* Template, const FVector& Location, const FRotator& Rotation, const ASurvivalCharacter* Instigator);
+
+	FORCEINLINE const FCombatFXStats& GetStats() const { return Stats; }
+
+	/**
+	 * Check if a sound of the concurrency group may play. If the group is full, the least important voice is stopped when the new sound beats it.
+	 * Importance is priority scaled by distance to the local view. Groups without a configured limit always pass
+	 */
+	bool CanPlayVoice(const FName& ConcurrencyGroup, const FVector& Location, const float Priority, const ASurvivalCharacter* Instigator);
+
+	/** Register a sound that got a voice from CanPlayVoice, so it counts against the group until it stops playing */
+	void AddVoice(const FName& ConcurrencyGroup, UAudioComponent* AudioComponent, const FVector& Location, const float Priority, const ASurvivalCharacter* Instigator);
+
+	/** Audio pools report here so created vs reused components show up in the stats */
+	void NotifyAudioComponentAcquired(const bool bCreated);
+
+protected:
+	/** max FX spawned per frame for remote characters. Local player's own FX are never limited */
+	UPROPERTY(Config)
+	int32 MaxSpawnsPerFrame;
+
+	/** FX further than this from the local view aren't played */
+	UPROPERTY(Config)
+	float MaxFXDistance;
+
+	/** max components kept per template, active or idle */
+	UPROPERTY(Config)
+	int32 MaxComponentsPerTemplate;
+
+	/** keeps pooled components alive */
+	UPROPERTY(Transient)
+	TArray<UParticleSystemComponent*> PooledComponents;
+
+	/** max simultaneous voices per concurrency group, ie Gunshot=8 */
+	UPROPERTY(Config)
+	TMap<FName, int32> ConcurrencyGroupLimits;
+
+	/** sounds further than this have no importance left, only priority decides */
+	UPROPERTY(Config)
+	float MaxVoiceDistance;
+
+	/** importance multiplier for the local player's own sounds so they never lose their voice to remote characters */
+	UPROPERTY(Config)
+	float LocalVoicePriorityScale;
+
+	struct FActiveVoice {
+		TWeakObjectPtr<UAudioComponent> AudioComponent;
+		/** pooled audio components get reused for other sounds, so remember which sound owns the voice */
+		const USoundBase* Sound = nullptr;
+		float Importance = 0.f;
+	};
+
+	TMap<FName, TArray<FActiveVoice>> ActiveVoices;
+
+	float GetVoiceImportance(const FVector& Location, const float Priority, const ASurvivalCharacter* Instigator) const;
+
+	struct FTemplatePool {
+		TArray<UParticleSystemComponent*> FreeComponents;
+		int32 NumComponents = 0;
+	};
+
+	TMap<TObjectKey<UParticleSystem>, FTemplatePool> Pools;
+
+	FCombatFXStats Stats;
+
+	int32 SpawnsThisFrame;
+
+	FVector LocalViewLocation;
+
+	bool bHasLocalView;
+
+	/** Check significance, distance and frame budget for a spawn at the location */
+	bool ShouldSpawnFX(const FVector& Location, const ASurvivalCharacter* Instigator);
+
+	/** Get an idle component of the template, creating one if the pool has room */
+	UParticleSystemComponent* AcquireComponent(UParticleSystem* Template);
+
+	UFUNCTION()
+	void OnFXFinished(UParticleSystemComponent* FinishedComponent);
+};
@@ -0,0 +1,253 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Weapons/ExplosionSubsystem.h"
+#include "Framework/SceneQuerySubsystem.h"
+#include "Weapons/HitRegistrationSubsystem.h"
+#include "Player/SurvivalCharacter.h"
+#include "Components/CapsuleComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/PlayerController.h"
+#include "TimerManager.h"
+
+static FAutoConsoleCommandWithWorldAndArgs ExplosionBenchmarkCommand(
+	TEXT("Survival.ExplosionBenchmark"),
+	TEXT("Server only. Spawn players around the local player, detonate explosions among them through the explosion subsystem and print how long until all damage is resolved. Args: [NumExplosions=20] [NumPlayers=60]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World) {
+		AGameModeBase* GameMode = World ? World->GetAuthGameMode() : nullptr;
+		UExplosionSubsystem* ExplosionSubsystem = World ? World->GetSubsystem<UExplosionSubsystem>() : nullptr;
+		if (!GameMode || !ExplosionSubsystem) {
+			UE_LOG(LogTemp, Warning, TEXT("Explosion benchmark has to run on the server"));
+			return;
+		}
+
+		const int32 NumExplosions = FMath::Max(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 20, 1);
+		const int32 NumPlayers = FMath::Max(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 60, 0);
+
+		struct FExplosionBenchmark {
+			TArray<TWeakObjectPtr<AActor>> SpawnedActors;
+			int32 NumPending = 0;
+			double StartTime = 0.0;
+			double QueueTime = 0.0;
+			uint64 StartFrame = 0;
+		};
+		TSharedRef<FExplosionBenchmark> Benchmark = MakeShared<FExplosionBenchmark>();
+
+		//players fighting over a compound around us, grenades landing among them
+		FVector Center = FVector::ZeroVector;
+		if (APlayerController* PC = World->GetFirstPlayerController()) {
+			if (APawn* Pawn = PC->GetPawn()) {
+				Center = Pawn->GetActorLocation();
+			}
+		}
+
+		TSubclassOf<APawn> PawnClass = GameMode->DefaultPawnClass;
+		if (!PawnClass || !PawnClass->IsChildOf<ASurvivalCharacter>()) {
+			PawnClass = ASurvivalCharacter::StaticClass();
+		}
+
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+		FRandomStream Stream(1234);
+		for (int32 i = 0; i < NumPlayers; ++i) {
+			const FVector Location = Center + FVector(Stream.FRandRange(-3000.f, 3000.f), Stream.FRandRange(-3000.f, 3000.f), 0.f);
+			Benchmark->SpawnedActors.Add(World->SpawnActor<APawn>(PawnClass, Location, FRotator::ZeroRotator, SpawnParams));
+		}
+
+		//explosions need a causer with authority that outlives them
+		AActor* DamageCauser = World->SpawnActor<AActor>(AActor::StaticClass(), Center, FRotator::ZeroRotator, SpawnParams);
+		Benchmark->SpawnedActors.Add(DamageCauser);
+
+		//next frame, so the spawned players are in the physics scene the overlaps run against
+		World->GetTimerManager().SetTimerForNextTick([Benchmark, World, ExplosionSubsystem, DamageCauser, Center, NumExplosions, NumPlayers]() {
+			//low damage so the run measures the pipeline, not a pile of deaths
+			FExplosionParams Params;
+			Params.BaseDamage = 1.f;
+
+			FSimpleDelegate OnResolved = FSimpleDelegate::CreateLambda([Benchmark, NumExplosions, NumPlayers]() {
+				if (--Benchmark->NumPending > 0) {
+					return;
+				}
+
+				UE_LOG(LogTemp, Log, TEXT("%d explosions among %d players: queued (overlaps) in %.3f ms, all damage resolved after %llu frames, %.3f ms"),
+					NumExplosions, NumPlayers, Benchmark->QueueTime * 1000.0, GFrameCounter - Benchmark->StartFrame, (FPlatformTime::Seconds() - Benchmark->StartTime) * 1000.0);
+
+				for (const TWeakObjectPtr<AActor>& SpawnedActor : Benchmark->SpawnedActors) {
+					if (SpawnedActor.IsValid()) {
+						SpawnedActor->Destroy();
+					}
+				}
+			});
+
+			FRandomStream OriginStream(4321);
+			Benchmark->NumPending = NumExplosions;
+			Benchmark->StartFrame = GFrameCounter;
+			Benchmark->StartTime = FPlatformTime::Seconds();
+			for (int32 i = 0; i < NumExplosions; ++i) {
+				const FVector Origin = Center + FVector(OriginStream.FRandRange(-3000.f, 3000.f), OriginStream.FRandRange(-3000.f, 3000.f), 50.f);
+				ExplosionSubsystem->QueueExplosion(DamageCauser, Origin, Params, OnResolved);
+			}
+			Benchmark->QueueTime = FPlatformTime::Seconds() - Benchmark->StartTime;
+		});
+	}));
+
+UExplosionSubsystem::UExplosionSubsystem()
+{
+	MaxVictimsPerExplosion = 32;
+
+	NextExplosionId = 0;
+}
+
+bool UExplosionSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	if (!Super::ShouldCreateSubsystem(Outer)) {
+		return false;
+	}
+
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UExplosionSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (Explosions.Num() > 0) {
+		ApplyReadyExplosions();
+	}
+}
+
+TStatId UExplosionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UExplosionSubsystem, STATGROUP_Tickables);
+}
+
+void UExplosionSubsystem::QueueExplosion(AActor* DamageCauser, const FVector& Origin, const FExplosionParams& Params, const FSimpleDelegate& OnResolved /*= FSimpleDelegate()*/)
+{
+	USceneQuerySubsystem* SceneQuery = GetWorld()->GetSubsystem<USceneQuerySubsystem>();
+	if (!DamageCauser || !DamageCauser->HasAuthority() || !SceneQuery) {
+		OnResolved.ExecuteIfBound();
+		return;
+	}
+
+	//id and victim index share the user data of the trace
+	const uint32 ExplosionId = NextExplosionId++ & 0xFFFFFF;
+
+	FExplosion& Explosion = Explosions.Add(ExplosionId);
+	Explosion.Origin = Origin;
+	Explosion.Params = Params;
+	Explosion.DamageCauser = DamageCauser;
+	Explosion.InstigatorController = DamageCauser->GetInstigatorController();
+	Explosion.OnResolved = OnResolved;
+
+	//one spatial query for candidates instead of testing every character in the world
+	TArray<FOverlapResult> Overlaps;
+	FCollisionQueryParams OverlapParams(SCENE_QUERY_STAT(ExplosionOverlap), false, DamageCauser);
+	GetWorld()->OverlapMultiByObjectType(Overlaps, Origin, FQuat::Identity, FCollisionObjectQueryParams(ECC_Pawn), FCollisionShape::MakeSphere(Params.OuterRadius), OverlapParams);
+
+	for (const FOverlapResult& Overlap : Overlaps) {
+		ASurvivalCharacter* Character = Cast<ASurvivalCharacter>(Overlap.GetActor());
+		if (Character && Character->IsAlive() && !Explosion.Victims.ContainsByPredicate([Character](const FExplosionVictim& Victim) { return Victim.Character == Character; })) {
+			FExplosionVictim& Victim = Explosion.Victims.AddDefaulted_GetRef();
+			Victim.Character = Character;
+			Victim.Location = Character->GetActorLocation();
+		}
+	}
+
+	Explosion.Victims.Sort([&Origin](const FExplosionVictim& A, const FExplosionVictim& B) {
+		return FVector::DistSquared(A.Location, Origin) < FVector::DistSquared(B.Location, Origin);
+	});
+	Explosion.Victims.SetNum(FMath::Min(Explosion.Victims.Num(), FMath::Clamp(MaxVictimsPerExplosion, 0, 255)));
+
+	//anything blocking between the explosion and the victim shields it, so the victim itself is ignored
+	const FOnSceneQueryComplete OnComplete = FOnSceneQueryComplete::CreateUObject(this, &UExplosionSubsystem::OnOcclusionTraceCompleted);
+	for (int32 i = 0; i < Explosion.Victims.Num(); ++i) {
+		FCollisionQueryParams TraceParams(SCENE_QUERY_STAT(ExplosionOcclusion), false, DamageCauser);
+		TraceParams.AddIgnoredActor(Explosion.Victims[i].Character.Get());
+
+		SceneQuery->QueueLineTrace(ESceneQueryCategory::Explosion, Origin, Explosion.Victims[i].Location, ECC_Visibility, TraceParams, OnComplete, (ExplosionId << 8) | uint32(i));
+		++Explosion.NumPendingTraces;
+	}
+}
+
+float UExplosionSubsystem::GetDamageAtDistance(const FExplosionParams& Params, const float Distance)
+{
+	if (Distance > Params.OuterRadius) {
+		return 0.f;
+	}
+
+	if (Distance <= Params.InnerRadius || Params.OuterRadius <= Params.InnerRadius) {
+		return Params.BaseDamage;
+	}
+
+	const float Alpha = (Distance - Params.InnerRadius) / (Params.OuterRadius - Params.InnerRadius);
+	return FMath::Lerp(Params.BaseDamage, Params.MinimumDamage, FMath::Pow(Alpha, Params.DamageFalloff));
+}
+
+void UExplosionSubsystem::ResolveExplosion(FExplosion& Explosion)
+{
+	for (FExplosionVictim& Victim : Explosion.Victims) {
+		Victim.Damage = Victim.bOccluded ? 0.f : GetDamageAtDistance(Explosion.Params, FVector::Dist(Victim.Location, Explosion.Origin));
+	}
+}
+
+void UExplosionSubsystem::OnOcclusionTraceCompleted(const FSceneQueryResult& Result)
+{
+	FExplosion* Explosion = Explosions.Find(Result.UserData >> 8);
+	const int32 VictimIndex = Result.UserData & 0xFF;
+	if (!Explosion || !Explosion->Victims.IsValidIndex(VictimIndex)) {
+		return;
+	}
+
+	FExplosionVictim& Victim = Explosion->Victims[VictimIndex];
+	Victim.bOccluded = Result.bBlockingHit;
+
+	if (ASurvivalCharacter* Character = Victim.Character.Get()) {
+		Victim.Hit = FHitResult(Character, Character->GetCapsuleComponent(), Victim.Location, (Victim.Location - Explosion->Origin).GetSafeNormal());
+	}
+
+	--Explosion->NumPendingTraces;
+}
+
+void UExplosionSubsystem::ApplyReadyExplosions()
+{
+	TArray<uint32, TInlineAllocator<8>> ResolvedIds;
+
+	for (TPair<uint32, FExplosion>& ExplosionPair : Explosions) {
+		FExplosion& Explosion = ExplosionPair.Value;
+		if (Explosion.NumPendingTraces > 0) {
+			continue;
+		}
+
+		ResolveExplosion(Explosion);
+
+		AActor* DamageCauser = Explosion.DamageCauser.Get();
+		UHitRegistrationSubsystem* HitRegistration = GetWorld()->GetSubsystem<UHitRegistrationSubsystem>();
+		if (DamageCauser && HitRegistration) {
+			FRadialDamageEvent DamageEvent;
+			DamageEvent.DamageTypeClass = Explosion.Params.DamageType;
+			DamageEvent.Origin = Explosion.Origin;
+			DamageEvent.Params = FRadialDamageParams(Explosion.Params.BaseDamage, Explosion.Params.MinimumDamage, Explosion.Params.InnerRadius, Explosion.Params.OuterRadius, Explosion.Params.DamageFalloff);
+
+			for (const FExplosionVictim& Victim : Explosion.Victims) {
+				ASurvivalCharacter* Character = Victim.Character.Get();
+				if (Character && Character->IsAlive() && Victim.Damage > 0.f) {
+					DamageEvent.ComponentHits.Reset();
+					DamageEvent.ComponentHits.Add(Victim.Hit);
+					HitRegistration->QueueRadialDamage(Character, Victim.Damage, DamageEvent, Explosion.InstigatorController.Get(), DamageCauser);
+				}
+			}
+		}
+
+		ResolvedIds.Add(ExplosionPair.Key);
+	}
+
+	for (const uint32 ExplosionId : ResolvedIds) {
+		FExplosion Explosion;
+		if (Explosions.RemoveAndCopyValue(ExplosionId, Explosion)) {
+			Explosion.OnResolved.ExecuteIfBound();
+		}
+	}
+}
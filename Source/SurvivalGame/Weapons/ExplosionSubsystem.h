@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GameFramework/DamageType.h"
+#include "ExplosionSubsystem.generated.h"
+
+class ASurvivalCharacter;
+struct FSceneQueryResult;
+
+/** Radial damage of an explosion */
+USTRUCT(BlueprintType)
+struct FExplosionParams {
+	GENERATED_BODY()
+
+	FExplosionParams() {
+		BaseDamage = 100.f;
+		MinimumDamage = 0.f;
+		InnerRadius = 100.f;
+		OuterRadius = 600.f;
+		DamageFalloff = 1.f;
+		DamageType = UDamageType::StaticClass();
+	}
+
+	/** damage inside the inner radius */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Explosion")
+	float BaseDamage;
+
+	/** damage at the outer radius */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Explosion")
+	float MinimumDamage;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Explosion")
+	float InnerRadius;
+
+	/** nothing further than this takes damage */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Explosion")
+	float OuterRadius;
+
+	/** exponent of the falloff between inner and outer radius. 1 is linear */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Explosion")
+	float DamageFalloff;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Explosion")
+	TSubclassOf<UDamageType> DamageType;
+};
+
+/** A character caught in an explosion */
+struct FExplosionVictim {
+	TWeakObjectPtr<ASurvivalCharacter> Character;
+	FVector Location = FVector::ZeroVector;
+	/** where the occlusion trace hit the victim, or a hit made up at the victim's location */
+	FHitResult Hit;
+	bool bOccluded = false;
+	float Damage = 0.f;
+};
+
+/** An explosion waiting for its occlusion traces */
+struct FExplosion {
+	FVector Origin = FVector::ZeroVector;
+	FExplosionParams Params;
+	TWeakObjectPtr<AActor> DamageCauser;
+	TWeakObjectPtr<AController> InstigatorController;
+	TArray<FExplosionVictim> Victims;
+	int32 NumPendingTraces = 0;
+	/** called once damage is applied */
+	FSimpleDelegate OnResolved;
+};
+
+/**
+ * Server side radial damage for throwables.
+ * An explosion gathers candidate characters with one overlap query, queues an occlusion trace per candidate with the scene query service,
+ * and once the traces are back, every explosion ready that frame is resolved in one pass and its damage queued with hit registration.
+ */
+UCLASS(Config = Game)
+class SURVIVALGAME_API UExplosionSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UExplosionSubsystem();
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/**
+	 * Explode at the origin. Server only.
+	 * DamageCauser has to stay alive until OnResolved runs, damage is credited to its owner
+	 */
+	void QueueExplosion(AActor* DamageCauser, const FVector& Origin, const FExplosionParams& Params, const FSimpleDelegate& OnResolved = FSimpleDelegate());
+
+	/** Get damage of a point at the distance from the explosion, with falloff between the radii */
+	static float GetDamageAtDistance(const FExplosionParams& Params, const float Distance);
+
+	/** Fill in damage of every victim of the explosion. Pure, no world needed */
+	static void ResolveExplosion(FExplosion& Explosion);
+
+protected:
+	/** characters considered per explosion, closest first */
+	UPROPERTY(Config)
+	int32 MaxVictimsPerExplosion;
+
+	/** explosions by id, id is sent along with the occlusion traces */
+	TMap<uint32, FExplosion> Explosions;
+
+	uint32 NextExplosionId;
+
+	void OnOcclusionTraceCompleted(const FSceneQueryResult& Result);
+
+	/** resolve every explosion whose traces are all back and queue its damage */
+	void ApplyReadyExplosions();
+};
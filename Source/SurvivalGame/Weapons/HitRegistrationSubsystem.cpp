@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Weapons/HitRegistrationSubsystem.h"
+#include "Player/SurvivalCharacter.h"
+#include "GameFramework/Controller.h"
+#include "Engine/World.h"
+
+UHitRegistrationSubsystem::UHitRegistrationSubsystem()
+{
+	DedupeWindow = 1.f;
+
+	NumDuplicateHits = 0;
+}
+
+bool UHitRegistrationSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	if (!Super::ShouldCreateSubsystem(Outer)) {
+		return false;
+	}
+
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UHitRegistrationSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	//tickables run after actors, so this is after every RPC and actor of the frame had a chance to queue
+	ResolveHits();
+
+	if (RecentHits.Num() > 0) {
+		const float ExpireTime = GetWorld()->GetTimeSeconds() - DedupeWindow;
+		for (auto It = RecentHits.CreateIterator(); It; ++It) {
+			if (It.Value() < ExpireTime) {
+				It.RemoveCurrent();
+			}
+		}
+	}
+}
+
+TStatId UHitRegistrationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UHitRegistrationSubsystem, STATGROUP_Tickables);
+}
+
+void UHitRegistrationSubsystem::QueuePointDamage(AActor* Victim, const float Damage, const FPointDamageEvent& DamageEvent, AController* EventInstigator, AActor* DamageCauser, const int32 BurstSeed /*= 0*/, const int32 ShotIndex /*= INDEX_NONE*/, const int32 PelletIndex /*= INDEX_NONE*/)
+{
+	if (!Victim || Damage == 0.f) {
+		return;
+	}
+
+	if (ShotIndex != INDEX_NONE) {
+		FHitKey Key;
+		Key.Source = DamageCauser;
+		Key.Victim = Victim;
+		Key.BurstSeed = BurstSeed;
+		Key.ShotIndex = ShotIndex;
+		Key.PelletIndex = PelletIndex;
+
+		if (RecentHits.Contains(Key)) {
+			++NumDuplicateHits;
+			//clients decide what gets sent, keep them from flooding the server log
+			UE_LOG(LogTemp, Verbose, TEXT("Dropped duplicate hit of burst %d shot %d pellet %d from %s on %s (%d so far)"), BurstSeed, ShotIndex, PelletIndex, *GetNameSafe(DamageCauser), *GetNameSafe(Victim), NumDuplicateHits);
+			return;
+		}
+		RecentHits.Add(Key, GetWorld()->GetTimeSeconds());
+	}
+
+	FQueuedDamage* Entry = nullptr;
+	if (AddDamage(Victim, Damage, EventInstigator, DamageCauser, Entry)) {
+		Entry->bRadial = false;
+		Entry->PointEvent = DamageEvent;
+		Entry->PointEvent.Damage = Damage;
+	}
+}
+
+void UHitRegistrationSubsystem::QueueRadialDamage(AActor* Victim, const float Damage, const FRadialDamageEvent& DamageEvent, AController* EventInstigator, AActor* DamageCauser)
+{
+	if (!Victim || Damage == 0.f) {
+		return;
+	}
+
+	FQueuedDamage* Entry = nullptr;
+	if (AddDamage(Victim, Damage, EventInstigator, DamageCauser, Entry)) {
+		Entry->bRadial = true;
+		Entry->RadialEvent = DamageEvent;
+	}
+}
+
+bool UHitRegistrationSubsystem::AddDamage(AActor* Victim, const float Damage, AController* EventInstigator, AActor* DamageCauser, FQueuedDamage*& OutEntry)
+{
+	OutEntry = QueuedDamage.FindByPredicate([Victim](const FQueuedDamage& Entry) { return Entry.Victim == Victim; });
+	if (!OutEntry) {
+		OutEntry = &QueuedDamage.AddDefaulted_GetRef();
+		OutEntry->Victim = Victim;
+	}
+
+	OutEntry->TotalDamage += Damage;
+
+	//strongest hit decides the event, and who gets credited if the victim dies
+	if (!OutEntry->DamageCauser.IsValid() || Damage > OutEntry->StrongestDamage) {
+		OutEntry->StrongestDamage = Damage;
+		OutEntry->EventInstigator = EventInstigator;
+		OutEntry->DamageCauser = DamageCauser;
+		return true;
+	}
+	return false;
+}
+
+void UHitRegistrationSubsystem::ResolveHits()
+{
+	if (QueuedDamage.Num() == 0) {
+		return;
+	}
+
+	//damage can kill and queue more (ie corpse or explosion logic), work on our own copy
+	TArray<FQueuedDamage> DamageToApply = MoveTemp(QueuedDamage);
+	QueuedDamage.Reset();
+
+	for (FQueuedDamage& Entry : DamageToApply) {
+		AActor* Victim = Entry.Victim.Get();
+		AActor* DamageCauser = Entry.DamageCauser.Get();
+		if (!Victim || !DamageCauser || Victim->IsPendingKill()) {
+			continue;
+		}
+
+		//victim may have been killed by an earlier hit of the same frame
+		const ASurvivalCharacter* VictimCharacter = Cast<ASurvivalCharacter>(Victim);
+		if (VictimCharacter && !VictimCharacter->IsAlive()) {
+			continue;
+		}
+
+		if (Entry.bRadial) {
+			Victim->TakeDamage(Entry.TotalDamage, Entry.RadialEvent, Entry.EventInstigator.Get(), DamageCauser);
+		}
+		else {
+			Entry.PointEvent.Damage = Entry.TotalDamage;
+			Victim->TakeDamage(Entry.TotalDamage, Entry.PointEvent, Entry.EventInstigator.Get(), DamageCauser);
+		}
+	}
+}
@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/EngineTypes.h"
+#include "HitRegistrationSubsystem.generated.h"
+
+/** Identifies a single hit so a resent or duplicated hit is only counted once */
+struct FHitKey {
+	/** weapon or character that produced the hit */
+	TObjectKey<AActor> Source;
+	TObjectKey<AActor> Victim;
+	/** shot indices restart every burst, so the burst is part of the key */
+	int32 BurstSeed = 0;
+	int32 ShotIndex = INDEX_NONE;
+	int32 PelletIndex = INDEX_NONE;
+
+	bool operator==(const FHitKey& Other) const {
+		return Source == Other.Source && Victim == Other.Victim && BurstSeed == Other.BurstSeed && ShotIndex == Other.ShotIndex && PelletIndex == Other.PelletIndex;
+	}
+
+	friend uint32 GetTypeHash(const FHitKey& Key) {
+		const uint32 SourceHash = HashCombine(GetTypeHash(Key.Source), GetTypeHash(Key.Victim));
+		const uint32 ShotHash = HashCombine(GetTypeHash(Key.BurstSeed), HashCombine(GetTypeHash(Key.ShotIndex), GetTypeHash(Key.PelletIndex)));
+		return HashCombine(SourceHash, ShotHash);
+	}
+};
+
+/**
+ * Server side queue for damage. Hits received during a frame are collected instead of applied inside the RPC,
+ * and resolved after actors tick: every victim takes one TakeDamage call with the sum of its hits, carried by its strongest hit.
+ * That's one health change and one health replication per victim per frame, even under shotgun or automatic fire.
+ */
+UCLASS(Config = Game)
+class SURVIVALGAME_API UHitRegistrationSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UHitRegistrationSubsystem();
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/**
+	 * Queue point damage (bullets, melee). Server only.
+	 * Hits with a shot index are dropped if the same source already registered that burst, shot and pellet on the victim recently
+	 */
+	void QueuePointDamage(AActor* Victim, const float Damage, const FPointDamageEvent& DamageEvent, AController* EventInstigator, AActor* DamageCauser, const int32 BurstSeed = 0, const int32 ShotIndex = INDEX_NONE, const int32 PelletIndex = INDEX_NONE);
+
+	/** Queue radial damage (explosions). Server only */
+	void QueueRadialDamage(AActor* Victim, const float Damage, const FRadialDamageEvent& DamageEvent, AController* EventInstigator, AActor* DamageCauser);
+
+	/** Apply everything queued so far */
+	void ResolveHits();
+
+protected:
+	/** seconds a registered shot is remembered for deduplication */
+	UPROPERTY(Config)
+	float DedupeWindow;
+
+	struct FQueuedDamage {
+		TWeakObjectPtr<AActor> Victim;
+		TWeakObjectPtr<AController> EventInstigator;
+		TWeakObjectPtr<AActor> DamageCauser;
+		float TotalDamage = 0.f;
+		/** damage of the hit whose event is passed on */
+		float StrongestDamage = 0.f;
+		bool bRadial = false;
+		FPointDamageEvent PointEvent;
+		FRadialDamageEvent RadialEvent;
+	};
+
+	/** queued damage, one entry per victim */
+	TArray<FQueuedDamage> QueuedDamage;
+
+	/** registered shots and when they were registered */
+	TMap<FHitKey, float> RecentHits;
+
+	int32 NumDuplicateHits;
+
+	/** Get the queue entry of the victim, adding it if needed. Return whether the hit is the strongest so far */
+	bool AddDamage(AActor* Victim, const float Damage, AController* EventInstigator, AActor* DamageCauser, FQueuedDamage*& OutEntry);
+};
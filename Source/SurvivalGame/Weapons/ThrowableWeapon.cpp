@@ -2,8 +2,12 @@
 
 
 #include "Weapons/ThrowableWeapon.h"
+#include "Weapons/CombatFXSubsystem.h"
+#include "Player/SurvivalCharacter.h"
 #include "Components/StaticMeshComponent.h"
 #include "GameFramework/ProjectileMovementComponent.h"
+#include "Kismet/GameplayStatics.h"
+#include "Sound/SoundCue.h"
 
 // Sets default values
 AThrowableWeapon::AThrowableWeapon()
@@ -13,8 +17,59 @@ AThrowableWeapon::AThrowableWeapon()
 
 	ThrowableMovement = CreateDefaultSubobject<UProjectileMovementComponent>("ThrowableMovement");
 	ThrowableMovement->InitialSpeed = 1000.f;
+	ThrowableMovement->bShouldBounce = true;
+
+	FuseTime = 3.f;
 
 	SetReplicates(true);
 	SetReplicateMovement(true);
 }
 
+void AThrowableWeapon::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (HasAuthority() && FuseTime > 0.f) {
+		GetWorldTimerManager().SetTimer(TimerHandle_Detonate, this, &AThrowableWeapon::Detonate, FuseTime, false);
+	}
+}
+
+void AThrowableWeapon::Detonate()
+{
+	const FVector Origin = GetActorLocation();
+
+	ThrowableMovement->StopMovementImmediately();
+	SetActorEnableCollision(false);
+	SetActorHiddenInGame(true);
+
+	MulticastPlayExplosionFX(Origin);
+
+	//damage is credited to our owner, so we have to stay around until it's applied
+	if (UExplosionSubsystem* ExplosionSubsystem = GetWorld()->GetSubsystem<UExplosionSubsystem>()) {
+		ExplosionSubsystem->QueueExplosion(this, Origin, ExplosionParams, FSimpleDelegate::CreateUObject(this, &AThrowableWeapon::OnExplosionResolved));
+	}
+	else {
+		OnExplosionResolved();
+	}
+}
+
+void AThrowableWeapon::OnExplosionResolved()
+{
+	//short life so the explosion FX multicast still finds us on clients
+	SetLifeSpan(1.f);
+}
+
+void AThrowableWeapon::MulticastPlayExplosionFX_Implementation(const FVector_NetQuantize& Location)
+{
+	if (GetNetMode() == NM_DedicatedServer) {
+		return;
+	}
+
+	if (UCombatFXSubsystem* FXSubsystem = GetWorld()->GetSubsystem<UCombatFXSubsystem>()) {
+		FXSubsystem->SpawnFXAtLocation(ExplosionFX, Location, FRotator::ZeroRotator, Cast<ASurvivalCharacter>(GetOwner()));
+	}
+
+	if (ExplosionSound) {
+		UGameplayStatics::PlaySoundAtLocation(this, ExplosionSound, Location);
+	}
+}
@@ -4,8 +4,12 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Weapons/ExplosionSubsystem.h"
 #include "ThrowableWeapon.generated.h"
 
+class UParticleSystem;
+class USoundCue;
+
 UCLASS()
 class SURVIVALGAME_API AThrowableWeapon : public AActor
 {
@@ -15,6 +19,8 @@ public:
 	// Sets default values for this actor's properties
 	AThrowableWeapon();
 
+	virtual void BeginPlay() override;
+
 protected:
 	UPROPERTY(EditDefaultsOnly, Category = "Components")
 	class UStaticMeshComponent* ThrowableMesh;
@@ -22,4 +28,27 @@ protected:
 	UPROPERTY(EditDefaultsOnly, Category = "Components")
 	class UProjectileMovementComponent* ThrowableMovement;
 
+	/** seconds after the throw before it detonates. Zero or less never detonates (ie a throwable that's just a distraction) */
+	UPROPERTY(EditDefaultsOnly, Category = "Explosion")
+	float FuseTime;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Explosion")
+	FExplosionParams ExplosionParams;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Effects")
+	UParticleSystem* ExplosionFX;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Effects")
+	USoundCue* ExplosionSound;
+
+	FTimerHandle TimerHandle_Detonate;
+
+	/** [server] explode and hand the damage to the explosion subsystem */
+	void Detonate();
+
+	/** [server] damage has been applied, nothing needs us anymore */
+	void OnExplosionResolved();
+
+	UFUNCTION(NetMulticast, Unreliable)
+	void MulticastPlayExplosionFX(const FVector_NetQuantize& Location);
 };
@@ -7,9 +7,14 @@
 
 #include "Player/SurvivalPlayerController.h"
 #include "Player/SurvivalCharacter.h"
+#include "Weapons/CombatFXSubsystem.h"
+#include "Framework/SceneQuerySubsystem.h"
+#include "Weapons/HitRegistrationSubsystem.h"
 #include "Components/SkeletalMeshComponent.h"
+#include "Engine/SkeletalMesh.h"
 #include "Components/AudioComponent.h"
 #include "Components/InventoryComponent.h"
+#include "Components/AudioPoolComponent.h"
 #include "Curves/CurveVector.h"
 #include "Kismet/GameplayStatics.h"
 #include "Particles/ParticleSystemComponent.h"
@@ -20,6 +25,17 @@
 #include "Items/AmmoItem.h"
 #include "DrawDebugHelpers.h"
 
+#if WITH_DEV_AUTOMATION_TESTS
+#include "Misc/AutomationTest.h"
+#endif
+
+static FName NAME_GunshotConcurrency("Gunshot");
+
+static TAutoConsoleVariable<int32> CVarDebugWeaponHits(
+	TEXT("Survival.DebugWeaponHits"),
+	0,
+	TEXT("Draw a point where every locally fired shot hit, for 30 seconds"));
+
 // Sets default values
 AWeapon::AWeapon()
 {
@@ -41,6 +57,7 @@ AWeapon::AWeapon()
 	AttachSocket1P = FName("GripPoint");
 	AttachSocket3P = FName("GripPoint");
 	MuzzleAttachPoint = FName("Muzzle");
+	SoundPriority = 1.f;
 
 	CurrentAmmoInClip = 0;
 	BurstCounter = 0;
@@ -49,6 +66,15 @@ AWeapon::AWeapon()
 	ADSTime = 0.5f;
 	RecoilResetSpeed = 5.f;
 	RecoilSpeed = 10.f;
+	RecoilTableSize = 64;
+	LastServerShotTime = 0.f;
+	FireCadenceTolerance = 0.25f;
+	FireAccumulator = 0.f;
+	BurstStartFrame = 0;
+	MaxFireCatchUpTime = 0.1f;
+	NumPendingShotTraces = 0;
+	BurstSeed = 0;
+	BurstShotIndex = 0;
 
 	PrimaryActorTick.bCanEverTick = true;
 	PrimaryActorTick.TickGroup = TG_PrePhysics;
@@ -64,8 +90,9 @@ void AWeapon::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeP
 
 	DOREPLIFETIME_CONDITION(AWeapon, CurrentAmmoInClip, COND_OwnerOnly);
 	DOREPLIFETIME_CONDITION(AWeapon, BurstCounter, COND_SkipOwner);
+	DOREPLIFETIME_CONDITION(AWeapon, BurstSeed, COND_SkipOwner);
 	DOREPLIFETIME_CONDITION(AWeapon, bPendingReload, COND_SkipOwner);
-	DOREPLIFETIME_CONDITION(AWeapon, Item, COND_InitialOnly); //only once
+	DOREPLIFETIME(AWeapon, Item); //pooled weapons get a new item on every equip
 	
 }
 
@@ -75,10 +102,35 @@ void AWeapon::BeginPlay()
 	Super::BeginPlay();
 	if (HasAuthority()) {
 		PawnOwner = Cast<ASurvivalCharacter>(GetOwner());
+
+		//every character shares the same body mesh, so the first weapon of the class to begin play builds its damage table instead of the first hit
+		if (PawnOwner && PawnOwner->GetMesh()) {
+			GetBoneDamageTable(PawnOwner->GetMesh()->SkeletalMesh);
+		}
+
+		//shots sent late by the client can arrive bunched up, and a hitch on the client sends a whole batch at once
+		const float MaxCatchUpShots = 2.f + (WeaponConfig.TimeBetweenShots > 0.f ? MaxFireCatchUpTime / WeaponConfig.TimeBetweenShots : 0.f);
+		FireCadence.SetConfig(WeaponConfig.TimeBetweenShots, MaxCatchUpShots);
 	}
 	
 }
 
+void AWeapon::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	//fire every shot that became due this frame, so fire rate doesn't depend on frame rate
+	if (bRefiring && WeaponConfig.TimeBetweenShots > 0.f && BurstStartFrame != GFrameCounter) {
+		FireAccumulator = FMath::Min(FireAccumulator + DeltaTime, FMath::Max(MaxFireCatchUpTime, WeaponConfig.TimeBetweenShots));
+
+		const int32 NumShots = FMath::FloorToInt(FireAccumulator / WeaponConfig.TimeBetweenShots);
+		if (NumShots > 0) {
+			FireAccumulator -= NumShots * WeaponConfig.TimeBetweenShots;
+			HandleFiring(NumShots);
+		}
+	}
+}
+
 void AWeapon::Destroyed()
 {
 	Super::Destroyed();
@@ -109,11 +161,14 @@ void AWeapon::ReturnAmmoToInventory()
 		if (UInventoryComponent* Inventory = PawnOwner->PlayerInventory) {
 			Inventory->TryAddItemFromClass(WeaponConfig.AmmoClass, CurrentAmmoInClip);
 		}
+		//weapon may be reused from the pool, don't give the ammo twice
+		CurrentAmmoInClip = 0;
 	}
 }
 
 void AWeapon::OnEquip()
 {
+	SetActorHiddenInGame(false);
 	AttachMeshToPawn();
 
 	bPendingEquip = true;
@@ -173,6 +228,40 @@ bool AWeapon::IsEquipped() const
 	return bIsEquipped;
 }
 
+void AWeapon::DeactivateToPool()
+{
+	StopSimulatingWeaponFire();
+	bIsEquipped = false;
+	bPendingEquip = false;
+	bWantsToFire = false;
+	CurrentState = EWeaponState::Idle;
+
+	DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+	SetActorHiddenInGame(true);
+	SetActorTickEnabled(false);
+
+	if (HasAuthority()) {
+		SetNetDormancy(DORM_DormantAll);
+	}
+}
+
+void AWeapon::ActivateFromPool()
+{
+	FlushNetDormancy();
+	SetNetDormancy(DORM_Awake);
+
+	SetActorTickEnabled(true);
+	bPendingReload = false;
+	bRefiring = false;
+	BurstCounter = 0;
+	BurstShotIndex = 0;
+	CurrentAmmoInClip = 0;
+	LastFireTime = 0.f;
+	FireAccumulator = 0.f;
+	PendingHits.Reset();
+	ForceNetUpdate();
+}
+
 bool AWeapon::IsAttachedToPawn() const
 {
 	return bIsEquipped || bPendingEquip;
@@ -180,8 +269,14 @@ bool AWeapon::IsAttachedToPawn() const
 
 void AWeapon::StartFire()
 {
+	//shooter picks the seed so recoil of the burst is known to everyone up front
+	if (!bWantsToFire && PawnOwner && PawnOwner->IsLocallyControlled()) {
+		BurstSeed = FMath::Rand();
+		BurstShotIndex = 0;
+	}
+
 	if (!HasAuthority()) {
-		ServerStartFire();
+		ServerStartFire(BurstSeed);
 	}
 
 	if (!bWantsToFire) {
@@ -328,12 +423,16 @@ void AWeapon::ClientStartReload_Implementation()
 }
 
 
-void AWeapon::ServerStartFire_Implementation()
+void AWeapon::ServerStartFire_Implementation(const int32 Seed)
 {
+	if (!bWantsToFire) {
+		BurstSeed = Seed;
+		BurstShotIndex = 0;
+	}
 	StartFire();
 }
 
-bool AWeapon::ServerStartFire_Validate()
+bool AWeapon::ServerStartFire_Validate(const int32 Seed)
 {
 	return true;
 }
@@ -400,34 +499,35 @@ void AWeapon::SimulateWeaponFire()
 	if (HasAuthority() && CurrentState != EWeaponState::Firing) {
 		return;
 	}
-	if (MuzzleFX) {
-		if (!bLoopedMuzzleFX || MuzzleFX == nullptr) {
-			if ((PawnOwner != nullptr) && PawnOwner->IsLocallyControlled()) {
-				if (PawnOwner->GetController() != nullptr) {
-					WeaponMesh->GetSocketLocation(MuzzleAttachPoint);
-					MuzzlePSC = UGameplayStatics::SpawnEmitterAttached(MuzzleFX, WeaponMesh, MuzzleAttachPoint);
-					MuzzlePSC->bOwnerNoSee = false;
-					MuzzlePSC->bOnlyOwnerSee = true;
-				}
-			}
-			else
-			{
-				MuzzlePSC = UGameplayStatics::SpawnEmitterAttached(MuzzleFX, WeaponMesh, MuzzleAttachPoint);
-			}
+
+	if (PawnOwner) {
+		PawnOwner->NotifyCombatActivity();
+	}
+
+	//far away or off screen shooters don't need 3p fire anims. Muzzle flashes are culled the same way by the FX pool
+	const bool bPlayCosmeticFX = PawnOwner == nullptr || PawnOwner->ShouldPlayCosmeticFX();
+
+	if (MuzzleFX && (!bLoopedMuzzleFX || MuzzlePSC == nullptr)) {
+		if (UCombatFXSubsystem* FXSubsystem = GetWorld()->GetSubsystem<UCombatFXSubsystem>()) {
+			MuzzlePSC = FXSubsystem->SpawnFXAttached(MuzzleFX, WeaponMesh, MuzzleAttachPoint, PawnOwner);
 		}
 	}
 
-	if (bLoopedFireAnim && bPlayingFireAnim) {
+	if (bLoopedFireAnim && bPlayingFireAnim && bPlayCosmeticFX) {
 		PlayWeaponAnimation(FireAnim);
 		bPlayingFireAnim = true;
 	}
 
 	if (bLoopedFireSound) {
-		if (FireAC == nullptr) FireAC = PlayWeaponSound(FireLoopSound);
+		//loop stops when a more important gunshot steals its voice, and its pooled component may be playing something else by now. Start it again
+		if (FireAC && (FireAC->Sound != FireLoopSound || !FireAC->IsPlaying())) {
+			FireAC = nullptr;
+		}
+		if (FireAC == nullptr) FireAC = PlayWeaponSound(FireLoopSound, NAME_GunshotConcurrency);
 	}
 	else
 	{
-		PlayWeaponSound(FireSound);
+		PlayWeaponSound(FireSound, NAME_GunshotConcurrency);
 	}
 
 	ASurvivalPlayerController* PC = (PawnOwner != nullptr) ? Cast<ASurvivalPlayerController>(PawnOwner->GetController()) : nullptr;
@@ -463,127 +563,206 @@ void AWeapon::StopSimulatingWeaponFire()
 	}
 
 	if (FireAC) {
-		FireAC->FadeOut(0.1f, 0.0f);
+		//pooled component might already play something else if our loop lost its voice
+		if (FireAC->Sound == FireLoopSound) {
+			FireAC->FadeOut(0.1f, 0.0f);
+		}
 		FireAC = nullptr;
 		PlayWeaponSound(FireFinishSound);
 	}
 }
 
-void AWeapon::HandleHit(const FHitResult& Hit, class ASurvivalCharacter* HitPlayer /*= nullptr*/)
+void AWeapon::HandleHits(const TArray<FWeaponHit>& Hits)
 {
-	if (Hit.GetActor()) {
-		UE_LOG(LogTemp, Warning, TEXT("Hit actor %s"), *Hit.GetActor()->GetName());
+	if (Hits.Num() == 0) {
+		return;
 	}
 
-	ServerHandleHit(Hit, HitPlayer);
+	ServerHandleHits(Hits);
 
-	if (HitPlayer && PawnOwner) {
+	bool bHitPlayer = false;
+	for (const FWeaponHit& WeaponHit : Hits) {
+		bHitPlayer |= WeaponHit.Hit.GetActor() && WeaponHit.Hit.GetActor()->IsA<ASurvivalCharacter>();
+	}
+
+	//one hitmarker for the whole batch
+	if (bHitPlayer && PawnOwner) {
 		if (ASurvivalPlayerController* PC = Cast<ASurvivalPlayerController>(PawnOwner->GetController())) {
 			PC->OnHitPlayer();
 		}
 	}
 }
 
-void AWeapon::ServerHandleHit_Implementation(const FHitResult& Hit, class ASurvivalCharacter* HitPlayer /*= nullptr*/)
+void AWeapon::ServerHandleHits_Implementation(const TArray<FWeaponHit>& Hits)
 {
-	if (PawnOwner) {
-		float DamageMultiplier = 1.f;
+	if (!PawnOwner) {
+		return;
+	}
 
-		for (auto& BoneDamageModifier : HitScanConfig.BoneDamageModifiers) {
-			if (Hit.BoneName == BoneDamageModifier.Key) {
-				DamageMultiplier = BoneDamageModifier.Value;
-				break;
-			}
-		}
+	UHitRegistrationSubsystem* HitRegistration = GetWorld()->GetSubsystem<UHitRegistrationSubsystem>();
+	if (!HitRegistration) {
+		return;
+	}
 
-		if (HitPlayer) {
-			UGameplayStatics::ApplyPointDamage(HitPlayer, HitScanConfig.Damage * DamageMultiplier, (Hit.TraceStart - Hit.TraceEnd).GetSafeNormal(), Hit, PawnOwner->GetController(), this, HitScanConfig.DamageType);
+	//pellets hitting the same player add up to one damage event at the end of the frame
+	for (const FWeaponHit& WeaponHit : Hits) {
+		const FHitResult& Hit = WeaponHit.Hit;
+		ASurvivalCharacter* HitPlayer = Cast<ASurvivalCharacter>(Hit.GetActor());
+		if (!HitPlayer || WeaponHit.PelletIndex >= HitScanConfig.PelletCount) {
+			continue;
 		}
+
+		const float Damage = HitScanConfig.Damage * GetBoneDamageMultiplier(HitPlayer->GetMesh(), Hit.BoneName);
+		const FPointDamageEvent DamageEvent(Damage, Hit, (Hit.TraceStart - Hit.TraceEnd).GetSafeNormal(), HitScanConfig.DamageType);
+
+		HitRegistration->QueuePointDamage(HitPlayer, Damage, DamageEvent, PawnOwner->GetController(), this, WeaponHit.BurstSeed, WeaponHit.ShotIndex, WeaponHit.PelletIndex);
 	}
 }
 
-bool AWeapon::ServerHandleHit_Validate(const FHitResult& Hit, class ASurvivalCharacter* HitPlayer /*= nullptr*/)
+bool AWeapon::ServerHandleHits_Validate(const TArray<FWeaponHit>& Hits)
 {
-	return true;
+	//a batch never has more pellets than a clip's worth of shots
+	return Hits.Num() <= GetAmmoPerClip() * HitScanConfig.PelletCount;
 }
 
-void AWeapon::FireShot()
+void AWeapon::FireShots(const int32 NumShots)
 {
-	if (PawnOwner) {
+	USceneQuerySubsystem* SceneQuery = GetWorld()->GetSubsystem<USceneQuerySubsystem>();
+	if (PawnOwner && SceneQuery) {
 		if (ASurvivalPlayerController* PC = Cast<ASurvivalPlayerController>(PawnOwner->GetController())) {
-			if (RecoilCurve) {
-				const FVector2D RecoilAmount(RecoilCurve->GetVectorValue(FMath::RandRange(0.f, 1.f)).X, RecoilCurve->GetVectorValue(FMath::RandRange(0.f, 1.f)).Y);
-				PC->ApplyRecoil(RecoilAmount, RecoilSpeed, RecoilResetSpeed, FireCameraShake);
-			}
-
 			FVector CamLoc;
 			FRotator CamRot;
 			PC->GetPlayerViewPoint(CamLoc, CamRot);
 
-			FHitResult Hit;
 			FCollisionQueryParams QueryParams;
 			QueryParams.AddIgnoredActor(this);
 			QueryParams.AddIgnoredActor(PawnOwner);
 
-			FVector FireDir = CamRot.Vector();// PawnOwner->IsAiming() ? CamRot.Vector() : FMath::VRandCone(CamRot.Vector(), FMath::DegreesToRadians(PawnOwner->IsAiming() ? 0.f : 5.f));
-			FVector TraceStart = CamLoc;
-			FVector TraceEnd = (FireDir * HitScanConfig.Distance) + CamLoc;
+			const FVector FireDir = CamRot.Vector();
+			const FVector TraceStart = CamLoc;
+
+			//shots of a frame all leave from this frame's aim, recoil kicks in for the next frame
+			FVector2D BatchRecoil = FVector2D::ZeroVector;
+			//results may come back after the next burst started, so they carry the seed they were fired with
+			const FOnSceneQueryComplete OnComplete = FOnSceneQueryComplete::CreateUObject(this, &AWeapon::OnShotTraceCompleted, BurstSeed);
 
-			if (GetWorld()->LineTraceSingleByChannel(Hit, TraceStart, TraceEnd, COLLISION_WEAPON, QueryParams)){
-				ASurvivalCharacter* HitChar = Cast<ASurvivalCharacter>(Hit.GetActor());
+			for (int32 i = 0; i < NumShots; ++i) {
+				if (RecoilCurve) {
+					BatchRecoil += GetRecoilForShot(BurstSeed, BurstShotIndex);
+				}
 
-				HandleHit(Hit, HitChar);
+				//traces of a frame are submitted together by the scene query service, results come back next frame
+				for (int32 PelletIndex = 0; PelletIndex < HitScanConfig.PelletCount; ++PelletIndex) {
+					const FVector TraceEnd = TraceStart + GetPelletDirection(FireDir, BurstSeed, BurstShotIndex, PelletIndex) * HitScanConfig.Distance;
+					const uint32 UserData = (uint32(BurstShotIndex) << 8) | uint32(PelletIndex);
 
-				FColor PointColor = FColor::Red;
-				DrawDebugPoint(GetWorld(), Hit.ImpactPoint, 5.f, PointColor, false, 30.f);
+					SceneQuery->QueueLineTrace(ESceneQueryCategory::Weapon, TraceStart, TraceEnd, COLLISION_WEAPON, QueryParams, OnComplete, UserData);
+					++NumPendingShotTraces;
+				}
+				++BurstShotIndex;
 			}
+
+			if (RecoilCurve && NumShots > 0) {
+				PC->ApplyRecoil(BatchRecoil, RecoilSpeed, RecoilResetSpeed, FireCameraShake);
+			}
+		}
+	}
+}
+
+void AWeapon::OnShotTraceCompleted(const FSceneQueryResult& Result, const int32 Seed)
+{
+	if (NumPendingShotTraces <= 0) {
+		return;
+	}
+	--NumPendingShotTraces;
+
+	if (Result.bBlockingHit) {
+		FWeaponHit& WeaponHit = PendingHits.AddDefaulted_GetRef();
+		WeaponHit.Hit = Result.Hit;
+		WeaponHit.BurstSeed = Seed;
+		WeaponHit.ShotIndex = Result.UserData >> 8;
+		WeaponHit.PelletIndex = Result.UserData & 0xFF;
+
+		if (UCombatFXSubsystem* FXSubsystem = GetWorld()->GetSubsystem<UCombatFXSubsystem>()) {
+			FXSubsystem->SpawnFXAtLocation(ImpactFX, WeaponHit.Hit.ImpactPoint, WeaponHit.Hit.ImpactNormal.Rotation(), PawnOwner);
+		}
+
+		if (CVarDebugWeaponHits.GetValueOnGameThread() != 0) {
+			DrawDebugPoint(GetWorld(), WeaponHit.Hit.ImpactPoint, 5.f, FColor::Red, false, 30.f);
 		}
 	}
+
+	//whole batch is back, send it in one message
+	if (NumPendingShotTraces == 0) {
+		HandleHits(PendingHits);
+		PendingHits.Reset();
+	}
 }
 
-void AWeapon::ServerHandleFiring_Implementation()
+void AWeapon::ServerHandleFiring_Implementation(const int32 NumShots)
 {
-	const bool bShouldUpdateAmmo = (CurrentAmmoInClip > 0 && CanFire());
-	HandleFiring();
+	const int32 AllowedShots = ValidateFireCadence(NumShots);
+	if (AllowedShots < NumShots) {
+		UE_LOG(LogTemp, Warning, TEXT("%s fired faster than the weapon allows, %d of %d shots rejected"), *GetNameSafe(PawnOwner), NumShots - AllowedShots, NumShots);
+	}
 
-	if (bShouldUpdateAmmo) {
+	if (AllowedShots <= 0) {
+		return;
+	}
+
+	const int32 ShotsToUpdate = CanFire() ? FMath::Min(AllowedShots, CurrentAmmoInClip) : 0;
+	HandleFiring(AllowedShots);
+
+	for (int32 i = 0; i < ShotsToUpdate; ++i) {
 		UseClipAmmo();
 
 		BurstCounter++;
+
+		//keep shot index in step with the client so the server knows the recoil of every shot
+		if (!PawnOwner || !PawnOwner->IsLocallyControlled()) {
+			++BurstShotIndex;
+		}
 	}
 }
 
-bool AWeapon::ServerHandleFiring_Validate()
+bool AWeapon::ServerHandleFiring_Validate(const int32 NumShots)
 {
-	return true;
+	return NumShots > 0 && NumShots <= GetAmmoPerClip();
 }
 
-void AWeapon::HandleReFiring()
+int32 AWeapon::ValidateFireCadence(const int32 NumShots)
 {
-	UWorld* MyWorld = GetWorld();
-
-	float SlackTimeThisFrame = FMath::Max(0.0f, (MyWorld->TimeSeconds - LastFireTime) - WeaponConfig.TimeBetweenShots);
-
-	if (bAllowAutomaticWeaponCatchup) {
-		TimerIntervalAdjustment -= SlackTimeThisFrame;
+	const float TimeSeconds = GetWorld()->GetTimeSeconds();
+	const float TimeSinceLastShot = TimeSeconds - LastServerShotTime;
+	LastServerShotTime = TimeSeconds;
+
+	//first shot brings the refire clock up to date, the rest of the batch has to fit in the catch-up time
+	int32 AllowedShots = 0;
+	while (AllowedShots < NumShots && FireCadence.TryConsumeShot(AllowedShots == 0 ? TimeSinceLastShot : 0.f, FireCadenceTolerance)) {
+		++AllowedShots;
 	}
-
-	HandleFiring();
+	return AllowedShots;
 }
 
-void AWeapon::HandleFiring()
+void AWeapon::HandleFiring(const int32 NumShots /*= 1*/)
 {
+	//can't fire more than what's left in the clip
+	const int32 ShotsToFire = FMath::Clamp(NumShots, 1, FMath::Max(CurrentAmmoInClip, 1));
+
 	if ((CurrentAmmoInClip > 0) && CanFire()) {
 		if (GetNetMode() != NM_DedicatedServer) {
 			SimulateWeaponFire();
 		}
 
 		if (PawnOwner && PawnOwner->IsLocallyControlled()) {
-			FireShot();
-			UseClipAmmo();
+			FireShots(ShotsToFire);
+
+			for (int32 i = 0; i < ShotsToFire; ++i) {
+				UseClipAmmo();
 
-			//update firing FX on remote clients if function was called on server
-			BurstCounter++;
+				//update firing FX on remote clients if function was called on server
+				BurstCounter++;
+			}
 		}
 	}
 	else if (CanReload()) {
@@ -601,18 +780,15 @@ void AWeapon::HandleFiring()
 
 	if (PawnOwner && PawnOwner->IsLocallyControlled()) {
 		if (!HasAuthority()) {
-			ServerHandleFiring();
+			ServerHandleFiring(ShotsToFire);
 		}
 
 		if (CurrentAmmoInClip <= 0 && CanReload()) {
 			StartReload();
 		}
 
+		//next shots are fired from Tick as soon as they're due
 		bRefiring = (CurrentState == EWeaponState::Firing && WeaponConfig.TimeBetweenShots > 0.f);
-		if (bRefiring) {
-			GetWorldTimerManager().SetTimer(TimerHandle_HandleFiring, this, &AWeapon::HandleReFiring, FMath::Max<float>(WeaponConfig.TimeBetweenShots + TimerIntervalAdjustment, SMALL_NUMBER), false);
-			TimerIntervalAdjustment = 0.f;
-		}
 	}
 
 	LastFireTime = GetWorld()->GetTimeSeconds();
@@ -622,12 +798,16 @@ void AWeapon::OnBurstStarted()
 {
 	// start firing, can be delayed to satisfy TimeBetweenShots
 	const float GameTime = GetWorld()->GetTimeSeconds();
-	if (LastFireTime > 0 && WeaponConfig.TimeBetweenShots > 0.0f &&	LastFireTime + WeaponConfig.TimeBetweenShots > GameTime)
+	BurstStartFrame = GFrameCounter;
+	if (PawnOwner && PawnOwner->IsLocallyControlled() && LastFireTime > 0 && WeaponConfig.TimeBetweenShots > 0.0f && LastFireTime + WeaponConfig.TimeBetweenShots > GameTime)
 	{
-		GetWorldTimerManager().SetTimer(TimerHandle_HandleFiring, this, &AWeapon::HandleFiring, LastFireTime + WeaponConfig.TimeBetweenShots - GameTime, false);
+		//let Tick fire the first shot once the time since the last one adds up
+		FireAccumulator = GameTime - LastFireTime;
+		bRefiring = true;
 	}
 	else
 	{
+		FireAccumulator = 0.f;
 		HandleFiring();
 	}
 }
@@ -643,11 +823,8 @@ void AWeapon::OnBurstFinished()
 		StopSimulatingWeaponFire();
 	}
 
-	GetWorldTimerManager().ClearTimer(TimerHandle_HandleFiring);
 	bRefiring = false;
-
-	// reset firing interval adjustment
-	TimerIntervalAdjustment = 0.0f;
+	FireAccumulator = 0.f;
 }
 
 
@@ -668,34 +845,28 @@ void AWeapon::SetWeaponState(EWeaponState NewState)
 	}
 }
 
-void AWeapon::DetermineWeaponState()
+//state a weapon should be in, given what it's doing and what it wants to do
+static EWeaponState GetNextWeaponState(const EWeaponState State, const bool bEquipped, const bool bPendingEquip, const bool bPendingReload, const bool bCanReload, const bool bWantsToFire, const bool bCanFire)
 {
-	EWeaponState NewState = EWeaponState::Idle;
-
-	if (bIsEquipped)
-	{
-		if (bPendingReload)
-		{
-			if (CanReload() == false)
-			{
-				NewState = CurrentState;
-			}
-			else
-			{
-				NewState = EWeaponState::Reloading;
-			}
+	if (bEquipped) {
+		if (bPendingReload) {
+			//reload that can't start keeps whatever we were doing
+			return bCanReload ? EWeaponState::Reloading : State;
 		}
-		else if (!bPendingReload && bWantsToFire && CanFire())
-		{
-			NewState = EWeaponState::Firing;
+		else if (bWantsToFire && bCanFire) {
+			return EWeaponState::Firing;
 		}
 	}
-	else if (bPendingEquip)
-	{
-		NewState = EWeaponState::Equipping;
+	else if (bPendingEquip) {
+		return EWeaponState::Equipping;
 	}
 
-	SetWeaponState(NewState);
+	return EWeaponState::Idle;
+}
+
+void AWeapon::DetermineWeaponState()
+{
+	SetWeaponState(GetNextWeaponState(CurrentState, bIsEquipped, bPendingEquip, bPendingReload, CanReload(), bWantsToFire, CanFire()));
 }
 
 void AWeapon::AttachMeshToPawn()
@@ -710,12 +881,12 @@ void AWeapon::AttachMeshToPawn()
 	}
 }
 
-UAudioComponent* AWeapon::PlayWeaponSound(USoundCue* Sound)
+UAudioComponent* AWeapon::PlayWeaponSound(USoundCue* Sound, const FName ConcurrencyGroup /*= NAME_None*/)
 {
 	UAudioComponent* AC = nullptr;
-	if (Sound && PawnOwner)
+	if (Sound && PawnOwner && PawnOwner->AudioPool && PawnOwner->ShouldPlayCosmeticAudio())
 	{
-		AC = UGameplayStatics::SpawnSoundAttached(Sound, PawnOwner->GetRootComponent());
+		AC = PawnOwner->AudioPool->PlaySound(Sound, ConcurrencyGroup, SoundPriority);
 	}
 
 	return AC;
@@ -724,7 +895,8 @@ UAudioComponent* AWeapon::PlayWeaponSound(USoundCue* Sound)
 float AWeapon::PlayWeaponAnimation(const FWeaponAnim& Animation)
 {
 	float Duration = 0.0f;
-	if (PawnOwner)
+	//insignificant remote characters skip 3p montages. Server still plays them as montage length drives reload timing
+	if (PawnOwner && (PawnOwner->HasAuthority() || PawnOwner->IsLocallyControlled() || PawnOwner->ShouldPlayCosmeticFX()))
 	{
 		UAnimMontage* UseAnim = PawnOwner->IsLocallyControlled() ? Animation.Pawn1P : Animation.Pawn3P;
 		if (UseAnim)
@@ -768,14 +940,102 @@ FVector AWeapon::GetCameraAim() const
 	return FinalAim;
 }
 
-FHitResult AWeapon::WeaponTrace(const FVector& StartTrace, const FVector& EndTrace) const
+const TArray<FVector2D>& AWeapon::GetRecoilTable() const
 {
-	// Perform trace to retrieve hit info
-	FCollisionQueryParams TraceParams(SCENE_QUERY_STAT(WeaponTrace), true, GetInstigator());
-	TraceParams.bReturnPhysicalMaterial = true;
+	const AWeapon* DefaultWeapon = GetClass()->GetDefaultObject<AWeapon>();
+	if (DefaultWeapon->RecoilTable.Num() == 0 && RecoilCurve && RecoilTableSize > 0) {
+		//seed from the class path so every machine samples the exact same table
+		FRandomStream RecoilStream(FCrc::StrCrc32(*GetClass()->GetPathName()));
+
+		DefaultWeapon->RecoilTable.SetNumUninitialized(RecoilTableSize);
+		for (FVector2D& Recoil : DefaultWeapon->RecoilTable) {
+			Recoil.X = RecoilCurve->GetVectorValue(RecoilStream.FRand()).X;
+			Recoil.Y = RecoilCurve->GetVectorValue(RecoilStream.FRand()).Y;
+		}
+	}
 
-	FHitResult Hit(ForceInit);
-	GetWorld()->LineTraceSingleByChannel(Hit, StartTrace, EndTrace, COLLISION_WEAPON, TraceParams);
+	return DefaultWeapon->RecoilTable;
+}
+
+FVector2D AWeapon::GetRecoilForShot(const int32 Seed, const int32 ShotIndex) const
+{
+	const TArray<FVector2D>& Table = GetRecoilTable();
+	if (Table.Num() == 0) {
+		return FVector2D::ZeroVector;
+	}
 
-	return Hit;
+	return Table[HashCombine(GetTypeHash(Seed), GetTypeHash(ShotIndex)) % Table.Num()];
 }
+
+FVector AWeapon::GetPelletDirection(const FVector& AimDir, const int32 Seed, const int32 ShotIndex, const int32 PelletIndex) const
+{
+	if (HitScanConfig.SpreadAngle <= 0.f) {
+		return AimDir;
+	}
+
+	FRandomStream PelletStream(HashCombine(HashCombine(GetTypeHash(Seed), GetTypeHash(ShotIndex)), GetTypeHash(PelletIndex)));
+	return PelletStream.VRandCone(AimDir, FMath::DegreesToRadians(HitScanConfig.SpreadAngle));
+}
+
+float AWeapon::GetBoneDamageMultiplier(const USkeletalMeshComponent* HitMesh, const FName& BoneName) const
+{
+	if (!HitMesh || !HitMesh->SkeletalMesh || BoneName.IsNone()) {
+		return 1.f;
+	}
+
+	const TArray<float>& DamageTable = GetBoneDamageTable(HitMesh->SkeletalMesh);
+	const int32 BoneIndex = HitMesh->GetBoneIndex(BoneName);
+
+	return DamageTable.IsValidIndex(BoneIndex) ? DamageTable[BoneIndex] : 1.f;
+}
+
+const TArray<float>& AWeapon::GetBoneDamageTable(const USkeletalMesh* Mesh) const
+{
+	static const TArray<float> EmptyTable;
+	if (!Mesh) {
+		return EmptyTable;
+	}
+
+	const AWeapon* DefaultWeapon = GetClass()->GetDefaultObject<AWeapon>();
+	if (const TArray<float>* CachedTable = DefaultWeapon->BoneDamageTables.Find(Mesh)) {
+		return *CachedTable;
+	}
+
+	const FReferenceSkeleton& RefSkeleton = Mesh->GetRefSkeleton();
+	TArray<float>& DamageTable = DefaultWeapon->BoneDamageTables.Add(Mesh);
+	DamageTable.SetNumUninitialized(RefSkeleton.GetNum());
+
+	//parents always come before their children in the reference skeleton, so inherited values are already resolved
+	for (int32 BoneIndex = 0; BoneIndex < RefSkeleton.GetNum(); ++BoneIndex) {
+		if (const float* Modifier = HitScanConfig.BoneDamageModifiers.Find(RefSkeleton.GetBoneName(BoneIndex))) {
+			DamageTable[BoneIndex] = *Modifier;
+		}
+		else {
+			const int32 ParentIndex = RefSkeleton.GetParentIndex(BoneIndex);
+			DamageTable[BoneIndex] = ParentIndex != INDEX_NONE ? DamageTable[ParentIndex] : 1.f;
+		}
+	}
+
+	return DamageTable;
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWeaponStateRulesTest, "SurvivalGame.Weapon.StateRules", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FWeaponStateRulesTest::RunTest(const FString& Parameters)
+{
+	//args : current state, equipped, pending equip, pending reload, can reload, wants to fire, can fire
+	TestEqual(TEXT("Unequipped weapon is idle"), GetNextWeaponState(EWeaponState::Firing, false, false, false, false, true, true), EWeaponState::Idle);
+	TestEqual(TEXT("Weapon being equipped is equipping"), GetNextWeaponState(EWeaponState::Idle, false, true, false, false, true, true), EWeaponState::Equipping);
+	TestEqual(TEXT("Held trigger fires"), GetNextWeaponState(EWeaponState::Idle, true, false, false, false, true, true), EWeaponState::Firing);
+	TestEqual(TEXT("Held trigger doesn't fire when weapon can't"), GetNextWeaponState(EWeaponState::Idle, true, false, false, false, true, false), EWeaponState::Idle);
+	TestEqual(TEXT("Released trigger stops firing"), GetNextWeaponState(EWeaponState::Firing, true, false, false, false, false, true), EWeaponState::Idle);
+	TestEqual(TEXT("Pending reload reloads over firing"), GetNextWeaponState(EWeaponState::Firing, true, false, true, true, true, true), EWeaponState::Reloading);
+	TestEqual(TEXT("Reload that can't start keeps firing"), GetNextWeaponState(EWeaponState::Firing, true, false, true, false, true, true), EWeaponState::Firing);
+	TestEqual(TEXT("Reload that can't start stays reloading"), GetNextWeaponState(EWeaponState::Reloading, true, false, true, false, true, true), EWeaponState::Reloading);
+
+	return true;
+}
+
+#endif
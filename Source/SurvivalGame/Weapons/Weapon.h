@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Weapons/WeaponFireCadence.h"
 #include "Weapon.generated.h"
 
 class UAnimMontage;
@@ -13,6 +14,7 @@ class UParticleSystemComponent;
 class UCameraShakeBase;
 class UForceFeedbackEffect;
 class USoundCue;
+struct FSceneQueryResult;
 
 UENUM(BlueprintType)
 enum class EWeaponState : uint8 {
@@ -62,11 +64,13 @@ struct FHitScanConfiguration {
 		Distance = 10000.f;
 		Damage = 25.f;
 		Radius = 0.f;
+		PelletCount = 1;
+		SpreadAngle = 0.f;
 		DamageType = UDamageType::StaticClass();
 	}
 
 	/** Map of bone-damage multiplier. If bone is child of given bone, it will use this damage amount
-	ex) Head,2 means double damage on head*/
+	ex) Head,2 means double damage on head and its children like jaw and eyes. neck_01 is the parent of head, so it needs its own entry. The closest listed ancestor wins*/
 	UPROPERTY(EditDefaultsOnly, Category = "Trace Info")
 	TMap<FName, float> BoneDamageModifiers;
 
@@ -79,12 +83,47 @@ struct FHitScanConfiguration {
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly ,Category = "Trace Info")
 	float Radius;
 
+	/** Traces per shot, ie 8 for a shotgun. Damage is per pellet */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly ,Category = "Trace Info", meta = (ClampMin = 1, ClampMax = 64))
+	int32 PelletCount;
+
+	/** Half angle of the spread cone in degrees. Pellet directions come from the burst seed, so every machine sees the same pattern */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly ,Category = "Trace Info", meta = (ClampMin = 0))
+	float SpreadAngle;
+
 	UPROPERTY(EditDefaultsOnly, Category = "WeaponStat")
 	TSubclassOf<UDamageType> DamageType;
 
 	
 };
 
+/** A shot that hit something, sent to the server in batches */
+USTRUCT()
+struct FWeaponHit {
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FHitResult Hit;
+
+	/** seed of the burst the shot belongs to. Shot indices restart every burst */
+	UPROPERTY()
+	int32 BurstSeed;
+
+	/** index of the shot in the burst */
+	UPROPERTY()
+	int32 ShotIndex;
+
+	/** index of the pellet in the shot */
+	UPROPERTY()
+	uint8 PelletIndex;
+
+	FWeaponHit() {
+		BurstSeed = 0;
+		ShotIndex = 0;
+		PelletIndex = 0;
+	}
+};
+
 UCLASS()
 class SURVIVALGAME_API AWeapon : public AActor
 {
@@ -99,6 +138,7 @@ public:
 public:
 	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 	void BeginPlay() override;
+	void Tick(float DeltaTime) override;
 	void Destroyed() override;
 
 protected:
@@ -119,6 +159,12 @@ protected:
 
 	bool IsEquipped() const;
 
+	/** [all] Hide, detach and stop ticking so the owner can keep this weapon for a later equip. Server also lets it go dormant */
+	void DeactivateToPool();
+
+	/** [server] Wake up a pooled weapon and reset its state before it gets a new item and is equipped again */
+	void ActivateFromPool();
+
 	/** check is mesh is already attached */
 	bool IsAttachedToPawn() const;
 
@@ -197,16 +243,6 @@ public:
 	USkeletalMeshComponent* WeaponMesh;
 
 protected:
-	//might not use this
-	/** Adjustment to handle frame rate affecting actual timer interval */
-	UPROPERTY(Transient)
-	float TimerIntervalAdjustment;
-
-	//might not use this 
-	/** Whether to allow automatic weapons to catch up with shorter refire cycles */
-	UPROPERTY(Config)
-	bool bAllowAutomaticWeaponCatchup = true;
-
 	/** firing audio (bLoopedFireSound set) */
 	UPROPERTY(Transient)
 	UAudioComponent* FireAC;
@@ -225,6 +261,10 @@ protected:
 	UPROPERTY(EditDefaultsOnly, Category = "Effects")
 	UParticleSystem* MuzzleFX;
 
+	/** FX played where our shots hit */
+	UPROPERTY(EditDefaultsOnly, Category = "Effects")
+	UParticleSystem* ImpactFX;
+
 	/** spawned component for muzzle fx */
 	UPROPERTY(Transient)
 	UParticleSystemComponent* MuzzlePSC;
@@ -252,6 +292,25 @@ protected:
 	UPROPERTY(EditDefaultsOnly, Category="Recoil")
 	float RecoilResetSpeed;
 
+	/** Number of recoil samples taken from RecoilCurve. Shots pick a sample by burst seed and shot index */
+	UPROPERTY(EditDefaultsOnly, Category="Recoil")
+	int32 RecoilTableSize;
+
+	/** Recoil samples of RecoilCurve. Only used on the class default object so all weapons of a class share it */
+	mutable TArray<FVector2D> RecoilTable;
+
+	/** Get recoil samples for this weapon class, sampling the curve the first time */
+	const TArray<FVector2D>& GetRecoilTable() const;
+
+public:
+	/** Get recoil of a shot in a burst. Same seed and shot index give the same recoil on every machine */
+	FVector2D GetRecoilForShot(const int32 Seed, const int32 ShotIndex) const;
+
+	/** Get direction of a pellet inside the spread cone around AimDir. Same seed, shot and pellet give the same direction on every machine */
+	FVector GetPelletDirection(const FVector& AimDir, const int32 Seed, const int32 ShotIndex, const int32 PelletIndex) const;
+
+protected:
+
 	UPROPERTY(EditDefaultsOnly, Category = "Effects")
 	UForceFeedbackEffect* FireForceFeedback;
 
@@ -276,6 +335,10 @@ protected:
 	UPROPERTY(EditDefaultsOnly, Category = Sound)
 	USoundCue* EquipSound;
 
+	/** how hard this weapon's gunshots hold on to a voice when too many guns fire at once. Scaled by distance to the listener */
+	UPROPERTY(EditDefaultsOnly, Category = Sound, meta = (ClampMin = 0.0))
+	float SoundPriority;
+
 	UPROPERTY(EditDefaultsOnly, Category = Animation)
 	FWeaponAnim EquipAnim;
 
@@ -313,6 +376,16 @@ protected:
 	/** weapon is refiring */
 	uint32 bRefiring;
 
+	/** [local] trigger time not yet spent on shots. Every frame fires floor(FireAccumulator / TimeBetweenShots) shots */
+	float FireAccumulator;
+
+	/** [local] frame the current burst started. Its time is already in FireAccumulator, so Tick doesn't add it again */
+	uint64 BurstStartFrame;
+
+	/** longest hitch a held trigger catches up on in a single frame. Server allows the same amount of catch-up */
+	UPROPERTY(EditDefaultsOnly, Category = "WeaponStat")
+	float MaxFireCatchUpTime;
+
 	/** time of last successful weapon fire */
 	float LastFireTime;
 
@@ -332,6 +405,13 @@ protected:
 	UPROPERTY(Transient, ReplicatedUsing = OnRep_BurstCounter)
 	int32 BurstCounter;
 
+	/** seed of the current burst, picked by the shooting client. Drives recoil of every shot in the burst */
+	UPROPERTY(Transient, Replicated)
+	int32 BurstSeed;
+
+	/** shots fired in the current burst */
+	int32 BurstShotIndex;
+
 	/** Handle for efficient management of OnEquipFinished timer */
 	FTimerHandle TimerHandle_OnEquipFinished;
 
@@ -341,15 +421,25 @@ protected:
 	/** Handle for efficient management of ReloadWeapon timer */
 	FTimerHandle TimerHandle_ReloadWeapon;
 
-	/** Handle for efficient management of HandleFiring timer */
-	FTimerHandle TimerHandle_HandleFiring;
+	/** [server] refire clock used to reject shots from clients firing faster than TimeBetweenShots */
+	FWeaponFireCadence FireCadence;
+
+	/** [server] time the last client shot was processed */
+	float LastServerShotTime;
+
+	/** fraction of TimeBetweenShots a client shot may arrive early before the server rejects it. Covers network jitter */
+	UPROPERTY(EditDefaultsOnly, Category = "WeaponStat")
+	float FireCadenceTolerance;
+
+	/** [server] check the client shots respect the weapon's fire rate. Return how many of them are allowed */
+	int32 ValidateFireCadence(const int32 NumShots);
 
 	////////////////////////////////////////////////
 	// SERVER-SIDE INPUT
 	////////////////////////////////////////////////
 
 	UFUNCTION(Reliable, Server, WithValidation)
-	void ServerStartFire();
+	void ServerStartFire(const int32 Seed);
 
 	UFUNCTION(Reliable, Server, WithValidation)
 	void ServerStopFire();
@@ -382,24 +472,30 @@ protected:
 	// REPLICATION & EFFECTS
 	////////////////////////////////////////////////
 
-	/** handle hit locally before asking server to process it */
-	void HandleHit(const FHitResult& Hit, class ASurvivalCharacter* HitPlayer = nullptr);
+	/** handle hits of a shot batch locally before asking server to process them */
+	void HandleHits(const TArray<FWeaponHit>& Hits);
 
 	UFUNCTION(Server, Reliable, WithValidation)
-	void ServerHandleHit(const FHitResult& Hit, class ASurvivalCharacter* HitPlayer = nullptr);
+	void ServerHandleHits(const TArray<FWeaponHit>& Hits);
+
+	/** [local] weapon specific fire implementation. All pellets of all shots of a frame are traced together and their hits sent in one message */
+	virtual void FireShots(const int32 NumShots);
+
+	/** queued trace of a pellet of the burst finished */
+	void OnShotTraceCompleted(const FSceneQueryResult& Result, const int32 Seed);
+
+	/** hits of the shot batch whose traces are still in flight */
+	TArray<FWeaponHit> PendingHits;
 
-	/** [local] weapon specific fire implementation */
-	virtual void FireShot();
+	/** shot traces still in flight */
+	int32 NumPendingShotTraces;
 
 	/** [server] fire & update ammo */
 	UFUNCTION(Reliable, Server, WithValidation)
-	void ServerHandleFiring();
+	void ServerHandleFiring(const int32 NumShots);
 
-	/** [local+server] handle weapon refire, compensating for slack time if the timer can't sample fast enough */
-	void HandleReFiring();
-
-	/** [local+server] handle weapon fire */
-	void HandleFiring();
+	/** [local+server] handle weapon fire. NumShots is how many shots became due this frame */
+	void HandleFiring(const int32 NumShots = 1);
 
 	/** [local + server] firing started */
 	virtual void OnBurstStarted();
@@ -420,7 +516,8 @@ protected:
 	// WEAPON USAGE HELPERS
 	////////////////////////////////////////////////
 
-	UAudioComponent* PlayWeaponSound(USoundCue* Sound);
+	/** play sound on the owner's audio pool. Sounds in a concurrency group compete for a limited number of voices */
+	UAudioComponent* PlayWeaponSound(USoundCue* Sound, const FName ConcurrencyGroup = NAME_None);
 
 	float PlayWeaponAnimation(const FWeaponAnim& Animation);
 
@@ -428,8 +525,18 @@ protected:
 
 	FVector GetCameraAim() const;
 
-	/** find hit */
-	FHitResult WeaponTrace(const FVector& StartTrace, const FVector& EndTrace) const;
+	////////////////////////////////////////////////
+	// BONE DAMAGE
+	////////////////////////////////////////////////
+
+	/** Get damage multiplier for hitting the given bone of the mesh */
+	float GetBoneDamageMultiplier(const USkeletalMeshComponent* HitMesh, const FName& BoneName) const;
+
+	/** Get bone index -> damage multiplier table of the mesh for this weapon class, building it the first time a weapon of the class needs it */
+	const TArray<float>& GetBoneDamageTable(const USkeletalMesh* Mesh) const;
+
+	/** Bone damage tables per skeletal mesh. Only used on the class default object, filled lazily the first time a weapon of the class needs a mesh, so all weapons of a class share them */
+	mutable TMap<TObjectKey<USkeletalMesh>, TArray<float>> BoneDamageTables;
 };
 
 
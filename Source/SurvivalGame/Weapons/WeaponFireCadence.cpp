@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Weapons/WeaponFireCadence.h"
+#include "HAL/IConsoleManager.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+#include "Misc/AutomationTest.h"
+#endif
+
+static FAutoConsoleCommand WeaponCadenceBenchmarkCommand(
+	TEXT("Survival.WeaponCadenceBenchmark"),
+	TEXT("Validate the fire cadence of headless weapons and print shots per second. Args: [NumWeapons=1000] [SimulatedSeconds=60]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args) {
+		const int32 NumWeapons = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+		const float SimulatedSeconds = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 60.f;
+
+		//fast automatic rifle, shots arrive every 60hz frame like a client's batched fire
+		const float TimeBetweenShots = 0.06f;
+		const float FrameTime = 1.f / 60.f;
+		const int32 NumFrames = FMath::CeilToInt(SimulatedSeconds / FrameTime);
+
+		TArray<FWeaponFireCadence> Weapons;
+		Weapons.SetNum(NumWeapons);
+		for (FWeaponFireCadence& Weapon : Weapons) {
+			Weapon.SetConfig(TimeBetweenShots, 2.f);
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		int64 TotalShots = 0;
+		for (FWeaponFireCadence& Weapon : Weapons) {
+			for (int32 Frame = 0; Frame < NumFrames; ++Frame) {
+				TotalShots += Weapon.TryConsumeShot(FrameTime) ? 1 : 0;
+			}
+		}
+		const double ElapsedTime = FMath::Max(FPlatformTime::Seconds() - StartTime, SMALL_NUMBER);
+
+		UE_LOG(LogTemp, Log, TEXT("Validated %lld shots of %d weapons in %.3f ms (%.2f million shots/sec)"), TotalShots, NumWeapons, ElapsedTime * 1000.0, TotalShots / ElapsedTime / 1000000.0);
+	}));
+
+FWeaponFireCadence::FWeaponFireCadence()
+	: TimeBetweenShots(0.2f)
+	, MaxCatchUpShots(1.f)
+	, RefireCooldown(0.f)
+{
+}
+
+void FWeaponFireCadence::SetConfig(const float InTimeBetweenShots, const float InMaxCatchUpShots)
+{
+	TimeBetweenShots = InTimeBetweenShots;
+	MaxCatchUpShots = InMaxCatchUpShots;
+}
+
+bool FWeaponFireCadence::TryConsumeShot(const float DeltaTime, const float Tolerance /*= 0.f*/)
+{
+	//a late shot may borrow time from the next one, but idle time doesn't bank unlimited shots
+	RefireCooldown = FMath::Max(RefireCooldown - DeltaTime, -TimeBetweenShots * MaxCatchUpShots);
+
+	if (RefireCooldown > TimeBetweenShots * Tolerance) {
+		return false;
+	}
+
+	RefireCooldown += TimeBetweenShots;
+	return true;
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWeaponFireCadenceTest, "SurvivalGame.Weapon.FireCadence", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FWeaponFireCadenceTest::RunTest(const FString& Parameters)
+{
+	const float TimeBetweenShots = 0.1f;
+
+	//shots on time are all accepted, shots faster than the fire rate are not
+	{
+		FWeaponFireCadence Cadence;
+		Cadence.SetConfig(TimeBetweenShots, 1.f);
+
+		bool bAllOnTimeAccepted = true;
+		for (int32 i = 0; i < 100; ++i) {
+			bAllOnTimeAccepted &= Cadence.TryConsumeShot(i == 0 ? 0.f : TimeBetweenShots);
+		}
+		TestTrue(TEXT("Shots at the fire rate are accepted"), bAllOnTimeAccepted);
+		TestFalse(TEXT("Shot at twice the fire rate is rejected"), Cadence.TryConsumeShot(TimeBetweenShots * 0.5f));
+	}
+
+	//tolerance lets jittered shots through, but only up to its fraction of TimeBetweenShots
+	{
+		FWeaponFireCadence Cadence;
+		Cadence.SetConfig(TimeBetweenShots, 1.f);
+		Cadence.TryConsumeShot(0.f);
+		TestTrue(TEXT("Shot within tolerance is accepted"), Cadence.TryConsumeShot(TimeBetweenShots * 0.8f, 0.25f));
+
+		FWeaponFireCadence StrictCadence;
+		StrictCadence.SetConfig(TimeBetweenShots, 1.f);
+		StrictCadence.TryConsumeShot(0.f);
+		TestFalse(TEXT("Shot early past tolerance is rejected"), StrictCadence.TryConsumeShot(TimeBetweenShots * 0.5f, 0.25f));
+	}
+
+	//a late batch catches up on at most MaxCatchUpShots, however long the gap was
+	{
+		const float MaxCatchUpShots = 2.f;
+		FWeaponFireCadence Cadence;
+		Cadence.SetConfig(TimeBetweenShots, MaxCatchUpShots);
+		Cadence.TryConsumeShot(0.f);
+
+		int32 BatchShots = 0;
+		while (BatchShots < 10 && Cadence.TryConsumeShot(BatchShots == 0 ? 10.f : 0.f)) {
+			++BatchShots;
+		}
+		TestEqual(TEXT("Batch after a long gap is capped by the catch-up"), BatchShots, 1 + FMath::FloorToInt(MaxCatchUpShots));
+	}
+
+	return true;
+}
+
+#endif
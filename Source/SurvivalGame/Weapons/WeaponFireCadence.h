@@ -0,0 +1,31 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Refire clock of a weapon in plain C++. Has no world, timers or actors.
+ * Server feeds it the time between client shots to check a client isn't firing faster than TimeBetweenShots allows
+ */
+class SURVIVALGAME_API FWeaponFireCadence
+{
+public:
+	FWeaponFireCadence();
+
+	/** MaxCatchUpShots is how many shots worth of refire time a late shot may catch up on, like AWeapon::MaxFireCatchUpTime */
+	void SetConfig(const float InTimeBetweenShots, const float InMaxCatchUpShots);
+
+	/** Advance the refire clock and try to take a single shot. Tolerance is a fraction of TimeBetweenShots a shot may come early */
+	bool TryConsumeShot(const float DeltaTime, const float Tolerance = 0.f);
+
+	float GetTimeBetweenShots() const { return TimeBetweenShots; }
+
+private:
+	float TimeBetweenShots;
+
+	float MaxCatchUpShots;
+
+	/** time until the next shot is allowed. Negative values are catch-up time owed to a late shot */
+	float RefireCooldown;
+};
@@ -0,0 +1,186 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "World/CookedLootTable.h"
+#include "World/ItemSpawn.h"
+#include "World/LootTableSampler.h"
+#include "Engine/DataTable.h"
+#include "Items/Item.h"
+
+namespace CookedLootTable
+{
+	const uint32 Magic = 0x4C4F4F54; //LOOT
+	/** bump when the layout changes, old blobs are then ignored until rebuilt */
+	const uint32 Version = 1;
+}
+
+void UCookedLootTable::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	//byte arrays serialize as one block
+	Ar << Blob;
+
+	if (Ar.IsLoading()) {
+		RefreshViews();
+	}
+}
+
+void UCookedLootTable::PostLoad()
+{
+	Super::PostLoad();
+
+#if WITH_EDITOR
+	//blob of an older version, compile it again so the editor keeps working until the asset is resaved
+	if (!Header && SourceTable) {
+		Rebuild();
+	}
+#endif
+}
+
+#if WITH_EDITOR
+void UCookedLootTable::PreSave(const class ITargetPlatform* TargetPlatform)
+{
+	Super::PreSave(TargetPlatform);
+
+	//the source table may have changed since, always save and cook what it holds now
+	Rebuild();
+}
+
+void UCookedLootTable::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	if (PropertyChangedEvent.GetPropertyName() == GET_MEMBER_NAME_CHECKED(UCookedLootTable, SourceTable)) {
+		Rebuild();
+	}
+}
+
+void UCookedLootTable::Rebuild()
+{
+	Blob.Reset();
+	ItemClasses.Reset();
+
+	if (SourceTable && SourceTable->GetRowStruct() && SourceTable->GetRowStruct()->IsChildOf(FLootTableRow::StaticStruct())) {
+		TArray<FLootTableRow*> LootRows;
+		SourceTable->GetAllRows("", LootRows);
+
+		TArray<float> Weights;
+		for (const FLootTableRow* LootRow : LootRows) {
+			Weights.Add(LootRow->Probability);
+		}
+
+		//same alias tables as the runtime sampler of the source table builds, so both draw the same rows
+		const FLootTableSampler Sampler(Weights);
+		const int32 NumRows = Sampler.Num();
+
+		if (NumRows > 0) {
+			TArray<float> Cumulative;
+			TArray<int32> Offsets;
+			TArray<uint16> Ids;
+			float TotalProbability = 0.f;
+			for (int32 i = 0; i < NumRows; ++i) {
+				TotalProbability += Sampler.GetProbability(i);
+				Cumulative.Add(TotalProbability);
+
+				Offsets.Add(Ids.Num());
+				for (const TSubclassOf<UItem>& ItemClass : LootRows[i]->Items) {
+					if (ItemClass) {
+						const int32 ItemId = ItemClasses.AddUnique(ItemClass);
+						check(ItemId <= MAX_uint16);
+						Ids.Add(uint16(ItemId));
+					}
+				}
+			}
+			Offsets.Add(Ids.Num());
+
+			FCookedLootTableHeader NewHeader;
+			NewHeader.Magic = CookedLootTable::Magic;
+			NewHeader.Version = CookedLootTable::Version;
+			NewHeader.NumRows = NumRows;
+			NewHeader.NumItemIds = Ids.Num();
+
+			auto Append = [this](const void* Data, const int32 Size) {
+				const int32 Offset = Blob.AddUninitialized(Size);
+				FMemory::Memcpy(Blob.GetData() + Offset, Data, Size);
+			};
+			Append(&NewHeader, sizeof(NewHeader));
+			Append(Sampler.GetKeepChances().GetData(), NumRows * sizeof(float));
+			Append(Sampler.GetAliases().GetData(), NumRows * sizeof(int32));
+			Append(Cumulative.GetData(), NumRows * sizeof(float));
+			Append(Offsets.GetData(), (NumRows + 1) * sizeof(int32));
+			Append(Ids.GetData(), Ids.Num() * sizeof(uint16));
+		}
+	}
+
+	RefreshViews();
+}
+#endif
+
+int32 UCookedLootTable::SampleRow(FRandomStream& Stream) const
+{
+	if (!Header) {
+		return INDEX_NONE;
+	}
+
+	//same order of rolls as FLootTableSampler::SampleIndex
+	const float SlotRoll = Stream.GetFraction();
+	const float AliasRoll = Stream.GetFraction();
+
+	const int32 Slot = FMath::Min(FMath::FloorToInt(SlotRoll * Header->NumRows), Header->NumRows - 1);
+	return AliasRoll < KeepChances[Slot] ? Slot : Aliases[Slot];
+}
+
+TArrayView<const uint16> UCookedLootTable::GetRowItemIds(const int32 Row) const
+{
+	if (!Header || Row < 0 || Row >= Header->NumRows) {
+		return TArrayView<const uint16>();
+	}
+	return TArrayView<const uint16>(ItemIds + RowItemOffsets[Row], RowItemOffsets[Row + 1] - RowItemOffsets[Row]);
+}
+
+float UCookedLootTable::GetProbability(const int32 Row) const
+{
+	if (!Header || Row < 0 || Row >= Header->NumRows) {
+		return 0.f;
+	}
+	return Row > 0 ? CumulativeWeights[Row] - CumulativeWeights[Row - 1] : CumulativeWeights[0];
+}
+
+void UCookedLootTable::RefreshViews()
+{
+	Header = nullptr;
+	KeepChances = nullptr;
+	Aliases = nullptr;
+	CumulativeWeights = nullptr;
+	RowItemOffsets = nullptr;
+	ItemIds = nullptr;
+
+	if (Blob.Num() < int32(sizeof(FCookedLootTableHeader))) {
+		return;
+	}
+
+	const FCookedLootTableHeader* BlobHeader = reinterpret_cast<const FCookedLootTableHeader*>(Blob.GetData());
+	if (BlobHeader->Magic != CookedLootTable::Magic || BlobHeader->Version != CookedLootTable::Version || BlobHeader->NumRows <= 0 || BlobHeader->NumItemIds < 0) {
+		return;
+	}
+
+	const int64 ExpectedSize = sizeof(FCookedLootTableHeader) + int64(BlobHeader->NumRows) * (sizeof(float) * 2 + sizeof(int32) * 2) + sizeof(int32) + int64(BlobHeader->NumItemIds) * sizeof(uint16);
+	if (Blob.Num() != ExpectedSize) {
+		UE_LOG(LogTemp, Warning, TEXT("Cooked loot table %s has a blob of %d bytes, expected %lld"), *GetName(), Blob.Num(), ExpectedSize);
+		return;
+	}
+
+	const uint8* Data = Blob.GetData() + sizeof(FCookedLootTableHeader);
+	KeepChances = reinterpret_cast<const float*>(Data);
+	Data += BlobHeader->NumRows * sizeof(float);
+	Aliases = reinterpret_cast<const int32*>(Data);
+	Data += BlobHeader->NumRows * sizeof(int32);
+	CumulativeWeights = reinterpret_cast<const float*>(Data);
+	Data += BlobHeader->NumRows * sizeof(float);
+	RowItemOffsets = reinterpret_cast<const int32*>(Data);
+	Data += (BlobHeader->NumRows + 1) * sizeof(int32);
+	ItemIds = reinterpret_cast<const uint16*>(Data);
+
+	Header = BlobHeader;
+}
@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "CookedLootTable.generated.h"
+
+class UItem;
+class UDataTable;
+
+/** Start of the cooked blob. Arrays follow in this order: keep chances, aliases, cumulative weights, row item offsets, item ids */
+struct FCookedLootTableHeader {
+	uint32 Magic;
+	uint32 Version;
+	int32 NumRows;
+	int32 NumItemIds;
+};
+
+/**
+ * Loot table compiled from a FLootTableRow data table when saved or cooked. Alias tables, cumulative weights and the items of every row
+ * are packed in one blob that loads with a single copy, and items are ids into ItemClasses, which load with the asset.
+ * Spawning from it draws the same rows for the same stream as FLootTableSampler does for the source table, without row maps or row structs.
+ */
+UCLASS(BlueprintType)
+class SURVIVALGAME_API UCookedLootTable : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+#if WITH_EDITORONLY_DATA
+	/** table this is compiled from */
+	UPROPERTY(EditAnywhere, Category="Loot")
+	UDataTable* SourceTable;
+#endif
+
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void PostLoad() override;
+#if WITH_EDITOR
+	virtual void PreSave(const class ITargetPlatform* TargetPlatform) override;
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+
+	/** Compile SourceTable into the blob */
+	UFUNCTION(CallInEditor, Category="Loot")
+	void Rebuild();
+#endif
+
+	/** Draw a row index. Same draws as FLootTableSampler::SampleIndex with the same stream. Safe to call from any thread */
+	int32 SampleRow(FRandomStream& Stream) const;
+
+	/** Get the item ids of the row, in row order */
+	TArrayView<const uint16> GetRowItemIds(const int32 Row) const;
+
+	TSubclassOf<UItem> GetItemClass(const uint16 ItemId) const { return ItemClasses.IsValidIndex(ItemId) ? ItemClasses[ItemId] : nullptr; }
+
+	int32 NumRows() const { return Header ? Header->NumRows : 0; }
+
+	/** Get the chance of drawing the row */
+	float GetProbability(const int32 Row) const;
+
+protected:
+	/** item classes, indexed by item id */
+	UPROPERTY(VisibleAnywhere, Category="Loot")
+	TArray<TSubclassOf<UItem>> ItemClasses;
+
+	/** header and arrays. Written little endian, like every platform we ship */
+	TArray<uint8> Blob;
+
+	/** views into the blob, null if it's empty or doesn't match this version */
+	const FCookedLootTableHeader* Header = nullptr;
+	const float* KeepChances = nullptr;
+	const int32* Aliases = nullptr;
+	const float* CumulativeWeights = nullptr;
+	const int32* RowItemOffsets = nullptr;
+	const uint16* ItemIds = nullptr;
+
+	/** Point the views into the blob after it was loaded or rebuilt */
+	void RefreshViews();
+};
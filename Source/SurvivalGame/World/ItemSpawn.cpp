@@ -3,6 +3,9 @@
 
 #include "World/ItemSpawn.h"
 #include "World/Pickup.h"
+#include "World/LootTableSampler.h"
+#include "World/CookedLootTable.h"
+#include "World/ItemSpawnSubsystem.h"
 #include "Items/Item.h"
 
 AItemSpawn::AItemSpawn()
@@ -11,60 +14,168 @@ AItemSpawn::AItemSpawn()
 	bNetLoadOnClient = false; // will never load on client, only get loaded on server
 
 	RespawnRange = FIntPoint(10, 30);
+
+	bSpawnActive = false;
+	bItemsPreRolled = false;
 }
 
 void AItemSpawn::BeginPlay()
 {
 	Super::BeginPlay();
 	if (HasAuthority()) {
+		//without the subsystem there's nothing to activate us, so behave as if a player is always near
+		if (UItemSpawnSubsystem* SpawnSubsystem = GetWorld()->GetSubsystem<UItemSpawnSubsystem>()) {
+			SpawnSubsystem->RegisterSpawn(this);
+		}
+		else {
+			bSpawnActive = true;
+		}
 		SpawnItem();
 	}
 }
 
+void AItemSpawn::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UItemSpawnSubsystem* SpawnSubsystem = GetWorld()->GetSubsystem<UItemSpawnSubsystem>()) {
+		SpawnSubsystem->UnregisterSpawn(this);
+	}
 
-void AItemSpawn::SpawnItem()
+	Super::EndPlay(EndPlayReason);
+}
+
+void AItemSpawn::ActivateSpawn()
+{
+	if (!bSpawnActive) {
+		bSpawnActive = true;
+		SpawnPickups();
+	}
+}
+
+void AItemSpawn::DeactivateSpawn()
 {
-	if (HasAuthority() && LootTable) {
-		TArray<FLootTableRow*> SpawnItems;
-		LootTable->GetAllRows("", SpawnItems);
+	if (!bSpawnActive) {
+		return;
+	}
+	bSpawnActive = false;
 
-		const FLootTableRow* LootRow = SpawnItems[FMath::RandRange(0, SpawnItems.Num() - 1)];
+	for (AActor* SpawnedActor : SpawnedPickups) {
+		APickup* Pickup = Cast<APickup>(SpawnedActor);
+		if (!IsValid(Pickup)) {
+			continue;
+		}
 
-		ensure(LootRow);
+		if (UItem* Item = Pickup->GetItem()) {
+			FRolledItem& RolledItem = RolledItems.AddDefaulted_GetRef();
+			RolledItem.ItemClass = Item->GetClass();
+			RolledItem.Quantity = Item->GetQuantity();
+		}
 
-		float ProbabilityRoll = FMath::FRandRange(0.f, 1.f);
+		//not taken, so don't let it queue a respawn
+		Pickup->OnDestroyed.RemoveDynamic(this, &AItemSpawn::OnItemTaken);
+		Pickup->Destroy();
+	}
+	SpawnedPickups.Empty();
+}
 
-		while (ProbabilityRoll > LootRow->Probability) {
-			LootRow = SpawnItems[FMath::RandRange(0, SpawnItems.Num() - 1)];
-			ProbabilityRoll = FMath::FRandRange(0.f, 1.f);
+void AItemSpawn::SpawnItem()
+{
+	if (HasAuthority()) {
+		RollItems();
+
+		if (bSpawnActive) {
+			SpawnPickups();
 		}
+	}
+}
 
-		if (LootRow && LootRow->Items.Num() && PickupClass) {
-			float angle = 0.f;
-			for (auto& ItemClass : LootRow->Items) {
-				const FVector LocationOffset = FVector(FMath::Cos(angle), FMath::Sin(angle), 0.f) * 50.f;
-				FActorSpawnParameters SpawnParams;
-				SpawnParams.bNoFail = true;
-				SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+void AItemSpawn::RollItems()
+{
+	if (bItemsPreRolled) {
+		bItemsPreRolled = false;
+		return;
+	}
 
-				const int32 ItemQuantity = ItemClass->GetDefaultObject<UItem>()->GetQuantity();
+	FRandomStream Stream(FMath::Rand());
+	if (CookedLootTable) {
+		RollLootRow(*CookedLootTable, Stream, RolledItems);
+	}
+	else {
+		TSharedPtr<const FLootTableSampler> LootSampler = FLootTableSampler::Get(LootTable);
+		if (LootSampler.IsValid()) {
+			RollLootRow(*LootSampler, Stream, RolledItems);
+		}
+	}
+}
 
-				FTransform SpawnTransform = GetActorTransform();
-				SpawnTransform.AddToTranslation(LocationOffset);
+void AItemSpawn::RollLootRow(const FLootTableSampler& LootSampler, FRandomStream& Stream, TArray<FRolledItem>& OutItems)
+{
+	const FLootTableRow* LootRow = LootSampler.Sample(Stream);
 
-				APickup* Pickup = GetWorld()->SpawnActor<APickup>(PickupClass, SpawnTransform, SpawnParams);
-				Pickup->InitializePickup(ItemClass, ItemQuantity);
-				Pickup->OnDestroyed.AddUniqueDynamic(this, &AItemSpawn::OnItemTaken);
+	ensure(LootRow);
 
-				SpawnedPickups.Add(Pickup);
+	if (LootRow) {
+		OutItems.Reset();
+		for (auto& ItemClass : LootRow->Items) {
+			if (ItemClass) {
+				FRolledItem& RolledItem = OutItems.AddDefaulted_GetRef();
+				RolledItem.ItemClass = ItemClass;
+				RolledItem.Quantity = ItemClass->GetDefaultObject<UItem>()->GetQuantity();
+			}
+		}
+	}
+}
+
+void AItemSpawn::RollLootRow(const UCookedLootTable& CookedLootTable, FRandomStream& Stream, TArray<FRolledItem>& OutItems)
+{
+	const int32 Row = CookedLootTable.SampleRow(Stream);
 
-				angle += (PI * 2.f) / LootRow->Items.Num();
+	ensure(Row != INDEX_NONE);
 
+	if (Row != INDEX_NONE) {
+		OutItems.Reset();
+		for (const uint16 ItemId : CookedLootTable.GetRowItemIds(Row)) {
+			if (TSubclassOf<UItem> ItemClass = CookedLootTable.GetItemClass(ItemId)) {
+				FRolledItem& RolledItem = OutItems.AddDefaulted_GetRef();
+				RolledItem.ItemClass = ItemClass;
+				RolledItem.Quantity = ItemClass->GetDefaultObject<UItem>()->GetQuantity();
 			}
 		}
 	}
 }
 
+void AItemSpawn::SetPreRolledItems(TArray<FRolledItem>&& Items)
+{
+	if (HasAuthority() && !HasActorBegunPlay()) {
+		RolledItems = MoveTemp(Items);
+		bItemsPreRolled = true;
+	}
+}
+
+void AItemSpawn::SpawnPickups()
+{
+	if (RolledItems.Num() && PickupClass) {
+		float angle = 0.f;
+		for (const FRolledItem& RolledItem : RolledItems) {
+			const FVector LocationOffset = FVector(FMath::Cos(angle), FMath::Sin(angle), 0.f) * 50.f;
+			FActorSpawnParameters SpawnParams;
+			SpawnParams.bNoFail = true;
+			SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+			FTransform SpawnTransform = GetActorTransform();
+			SpawnTransform.AddToTranslation(LocationOffset);
+
+			APickup* Pickup = GetWorld()->SpawnActor<APickup>(PickupClass, SpawnTransform, SpawnParams);
+			Pickup->InitializePickup(RolledItem.ItemClass, RolledItem.Quantity);
+			Pickup->OnDestroyed.AddUniqueDynamic(this, &AItemSpawn::OnItemTaken);
+
+			SpawnedPickups.Add(Pickup);
+
+			angle += (PI * 2.f) / RolledItems.Num();
+		}
+		RolledItems.Empty();
+	}
+}
+
 void AItemSpawn::OnItemTaken(AActor* DestroyedActor)
 {
 	if (HasAuthority()) {
@@ -72,7 +183,13 @@ void AItemSpawn::OnItemTaken(AActor* DestroyedActor)
 
 		//if all pickups were taken, queue a respawn
 		if (SpawnedPickups.Num() <= 0) {
-			GetWorldTimerManager().SetTimer(TimerHandle_RespawnItem, this, &AItemSpawn::SpawnItem, FMath::RandRange(RespawnRange.GetMin(), RespawnRange.GetMax()), false);
+			const float RespawnDelay = FMath::RandRange(RespawnRange.GetMin(), RespawnRange.GetMax());
+			if (UItemSpawnSubsystem* SpawnSubsystem = GetWorld()->GetSubsystem<UItemSpawnSubsystem>()) {
+				SpawnSubsystem->ScheduleRespawn(this, RespawnDelay);
+			}
+			else {
+				GetWorldTimerManager().SetTimer(TimerHandle_RespawnItem, this, &AItemSpawn::SpawnItem, RespawnDelay, false);
+			}
 		}
 	}
 }
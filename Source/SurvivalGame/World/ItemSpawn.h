@@ -21,6 +21,19 @@ public:
 	float Probability = 1.f;
 };
 
+/** An item a spawn point rolled but doesn't have a pickup in the world for right now */
+USTRUCT()
+struct FRolledItem
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY()
+	TSubclassOf<class UItem> ItemClass;
+
+	UPROPERTY()
+	int32 Quantity = 0;
+};
+
 UCLASS()
 class SURVIVALGAME_API AItemSpawn : public ATargetPoint
 {
@@ -32,6 +45,10 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Loot")
 	class UDataTable* LootTable;
 
+	/** Compiled loot table. Used instead of LootTable when set */
+	UPROPERTY(EditAnywhere, Category = "Loot")
+	class UCookedLootTable* CookedLootTable;
+
 	/** as pickup use blueprint base, we use uproperty to select it */
 	UPROPERTY(EditDefaultsOnly, Category = "Loot")
 	TSubclassOf<class APickup> PickupClass;
@@ -40,17 +57,48 @@ public:
 	UPROPERTY(EditDefaultsOnly, Category = "Loot")
 	FIntPoint RespawnRange;
 
+	/** Spawn pickups for the rolled items. Called by UItemSpawnSubsystem when a player comes near */
+	void ActivateSpawn();
+
+	/** Despawn pickups nobody took, remembering what they held. Called by UItemSpawnSubsystem when every player left */
+	void DeactivateSpawn();
+
+	FORCEINLINE bool IsSpawnActive() const { return bSpawnActive; }
+
+	/** Roll new loot, and spawn it in if the spawn point is active */
+	UFUNCTION()
+	void SpawnItem();
+
+	/** Draw one row of the loot table into items. Safe to call off the game thread */
+	static void RollLootRow(const class FLootTableSampler& LootSampler, FRandomStream& Stream, TArray<FRolledItem>& OutItems);
+	static void RollLootRow(const class UCookedLootTable& CookedLootTable, FRandomStream& Stream, TArray<FRolledItem>& OutItems);
+
+	/** Use items rolled ahead of time, ie at map load, instead of rolling them on the first spawn */
+	void SetPreRolledItems(TArray<FRolledItem>&& Items);
+
 protected:
+	/** only used without UItemSpawnSubsystem, which schedules respawns of every spawn point itself */
 	FTimerHandle TimerHandle_RespawnItem;
 
 	UPROPERTY()
 	TArray<AActor*> SpawnedPickups;
 
+	/** items rolled but not spawned in, because no player is near or they were despawned. Partly taken stacks keep their remaining quantity */
+	UPROPERTY()
+	TArray<FRolledItem> RolledItems;
+
+	/** true while a player is near, so rolled items get pickups right away */
+	bool bSpawnActive;
+
+	/** RolledItems were rolled ahead of time, so the first spawn doesn't roll again */
+	bool bItemsPreRolled;
 
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
-	UFUNCTION()
-	void SpawnItem();
+	void RollItems();
+
+	void SpawnPickups();
 
 	// this is bound to the item being destroyed, so we cna queue up another item to be spawned in
 	UFUNCTION()
@@ -0,0 +1,329 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "World/ItemSpawnSubsystem.h"
+#include "World/ItemSpawn.h"
+#include "World/LootableChest.h"
+#include "World/LootTableSampler.h"
+#include "World/CookedLootTable.h"
+#include "Components/InventoryComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/Pawn.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "Async/ParallelFor.h"
+
+static TAutoConsoleVariable<int32> CVarParallelLootPreRoll(
+	TEXT("Survival.ParallelLootPreRoll"),
+	1,
+	TEXT("Roll the loot of every item spawn and every chest that isn't on demand in parallel when the map begins play, instead of one by one in their BeginPlay.\n")
+	TEXT("On demand chests are never rolled at load, they only pick a seed.\n")
+	TEXT("Map ready time is logged either way, to compare"));
+
+static FAutoConsoleCommandWithWorld ItemSpawnStatsCommand(
+	TEXT("Survival.ItemSpawnStats"),
+	TEXT("Print item spawn point counts and respawn queue depth and latency"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (UItemSpawnSubsystem* SpawnSubsystem = World ? World->GetSubsystem<UItemSpawnSubsystem>() : nullptr) {
+			const FItemRespawnStats& Stats = SpawnSubsystem->GetRespawnStats();
+			UE_LOG(LogTemp, Log, TEXT("Item spawns: %d registered, %d active"), SpawnSubsystem->GetNumSpawns(), SpawnSubsystem->GetNumActiveSpawns());
+			UE_LOG(LogTemp, Log, TEXT("Item respawns: %d queued (peak %d), %d scheduled, %d spawned, %d cancelled, latency avg %.3f s max %.3f s"),
+				SpawnSubsystem->GetRespawnQueueDepth(), Stats.PeakQueueDepth, Stats.Scheduled, Stats.Spawned, Stats.Cancelled,
+				Stats.Spawned > 0 ? Stats.TotalLatency / Stats.Spawned : 0.f, Stats.MaxLatency);
+		}
+	}));
+
+UItemSpawnSubsystem::UItemSpawnSubsystem()
+{
+	ActivationRadius = 8000.f; //80 meter
+	DeactivationRadius = 10000.f;
+	GridCellSize = 8000.f;
+	UpdateInterval = 0.5f;
+	MaxRespawnsPerFrame = 8;
+	RespawnTickInterval = 0.1f;
+
+	TimeSinceUpdate = 0.f;
+	ReadyRespawnsHead = 0;
+	NextRespawnId = 1;
+
+	MapBeginPlayTime = 0.0;
+	bReportMapReady = false;
+}
+
+bool UItemSpawnSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	if (!Super::ShouldCreateSubsystem(Outer)) {
+		return false;
+	}
+
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UItemSpawnSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	//config is only loaded after the constructor
+	SpawnGrid = TSpatialHashGrid<AItemSpawn*>(GridCellSize);
+	RespawnWheel = THierarchicalTimingWheel<FScheduledRespawn>(RespawnTickInterval);
+}
+
+void UItemSpawnSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	//loot is only rolled by the server
+	if (InWorld.GetNetMode() == NM_Client) {
+		return;
+	}
+
+	//subsystems begin play before actors do, so this runs before any chest or spawn point rolls on its own
+	MapBeginPlayTime = FPlatformTime::Seconds();
+	bReportMapReady = true;
+
+	if (CVarParallelLootPreRoll.GetValueOnGameThread() != 0) {
+		PreRollLoot(InWorld);
+	}
+}
+
+void UItemSpawnSubsystem::PreRollLoot(UWorld& InWorld)
+{
+	struct FPreRollJob {
+		ALootableChest* Chest = nullptr;
+		AItemSpawn* Spawn = nullptr;
+		TSharedPtr<const FLootTableSampler> LootSampler;
+		const UCookedLootTable* CookedLootTable = nullptr;
+		FIntPoint LootRolls;
+		int32 Capacity = 0;
+		float WeightCapacity = 0.f;
+		int32 Seed = 0;
+		TArray<FRolledItem> Items;
+	};
+
+	//everything touching actors and the sampler cache happens here on the game thread, workers only roll
+	TArray<FPreRollJob> Jobs;
+	int32 NumChests = 0;
+	int32 NumOnDemandChests = 0;
+	for (TActorIterator<ALootableChest> It(&InWorld); It; ++It) {
+		//on demand chests only pick a seed at begin play, which already decides their contents. Rolling them now would bring back the load time and memory they save
+		if (It->bGenerateLootOnDemand) {
+			++NumOnDemandChests;
+			continue;
+		}
+
+		FPreRollJob Job;
+		Job.CookedLootTable = It->CookedLootTable;
+		if (!Job.CookedLootTable) {
+			Job.LootSampler = FLootTableSampler::Get(It->LootTable);
+		}
+		if (Job.CookedLootTable || Job.LootSampler.IsValid()) {
+			Job.Chest = *It;
+			Job.LootRolls = It->LootRolls;
+			Job.Capacity = It->Inventory->GetCapacity();
+			Job.WeightCapacity = It->Inventory->GetWeightCapacity();
+			Job.Seed = FMath::Rand();
+			Jobs.Add(MoveTemp(Job));
+			++NumChests;
+		}
+	}
+	for (TActorIterator<AItemSpawn> It(&InWorld); It; ++It) {
+		FPreRollJob Job;
+		Job.CookedLootTable = It->CookedLootTable;
+		if (!Job.CookedLootTable) {
+			Job.LootSampler = FLootTableSampler::Get(It->LootTable);
+		}
+		if (Job.CookedLootTable || Job.LootSampler.IsValid()) {
+			Job.Spawn = *It;
+			Job.Seed = FMath::Rand();
+			Jobs.Add(MoveTemp(Job));
+		}
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	ParallelFor(Jobs.Num(), [&Jobs](int32 Index) {
+		FPreRollJob& Job = Jobs[Index];
+		if (Job.Chest && Job.CookedLootTable) {
+			ALootableChest::RollLootContents(*Job.CookedLootTable, Job.LootRolls, Job.Seed, Job.Capacity, Job.WeightCapacity, Job.Items);
+		}
+		else if (Job.Chest) {
+			ALootableChest::RollLootContents(*Job.LootSampler, Job.LootRolls, Job.Seed, Job.Capacity, Job.WeightCapacity, Job.Items);
+		}
+		else {
+			FRandomStream Stream(Job.Seed);
+			if (Job.CookedLootTable) {
+				AItemSpawn::RollLootRow(*Job.CookedLootTable, Stream, Job.Items);
+			}
+			else {
+				AItemSpawn::RollLootRow(*Job.LootSampler, Stream, Job.Items);
+			}
+		}
+	});
+	const double RollTime = FPlatformTime::Seconds() - StartTime;
+
+	for (FPreRollJob& Job : Jobs) {
+		if (Job.Chest) {
+			Job.Chest->SetPreRolledLoot(Job.Seed, MoveTemp(Job.Items));
+		}
+		else {
+			Job.Spawn->SetPreRolledItems(MoveTemp(Job.Items));
+		}
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Pre-rolled loot of %d chests and %d item spawns in %.2f ms, %d on demand chests left to roll when opened"), NumChests, Jobs.Num() - NumChests, RollTime * 1000.0, NumOnDemandChests);
+}
+
+void UItemSpawnSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	//first tick is after every actor's BeginPlay
+	if (bReportMapReady) {
+		bReportMapReady = false;
+		//either way item spawns and chests that aren't on demand roll during load, and on demand chests only pick a seed
+		UE_LOG(LogTemp, Log, TEXT("Map ready %.2f ms after begin play, item spawns and non on demand chests rolled %s"),
+			(FPlatformTime::Seconds() - MapBeginPlayTime) * 1000.0, CVarParallelLootPreRoll.GetValueOnGameThread() != 0 ? TEXT("in parallel before begin play") : TEXT("one by one in their BeginPlay"));
+	}
+
+	TimeSinceUpdate += DeltaTime;
+	if (TimeSinceUpdate >= UpdateInterval) {
+		TimeSinceUpdate = 0.f;
+		UpdateActiveSpawns();
+	}
+
+	ProcessRespawns(DeltaTime);
+}
+
+TStatId UItemSpawnSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UItemSpawnSubsystem, STATGROUP_Tickables);
+}
+
+void UItemSpawnSubsystem::RegisterSpawn(AItemSpawn* Spawn)
+{
+	if (Spawn && !SpawnLocations.Contains(Spawn)) {
+		const FVector Location = Spawn->GetActorLocation();
+		SpawnGrid.Add(Spawn, Location);
+		SpawnLocations.Add(Spawn, Location);
+	}
+}
+
+void UItemSpawnSubsystem::UnregisterSpawn(AItemSpawn* Spawn)
+{
+	FVector Location;
+	if (SpawnLocations.RemoveAndCopyValue(Spawn, Location)) {
+		SpawnGrid.Remove(Spawn, Location);
+		ActiveSpawns.RemoveSwap(Spawn);
+	}
+	CancelRespawn(Spawn);
+}
+
+void UItemSpawnSubsystem::ScheduleRespawn(AItemSpawn* Spawn, const float Delay)
+{
+	if (!Spawn) {
+		return;
+	}
+
+	FScheduledRespawn Respawn;
+	Respawn.Spawn = Spawn;
+	Respawn.Id = NextRespawnId++;
+	Respawn.DueTime = GetWorld()->GetTimeSeconds() + Delay;
+
+	if (RespawnIds.Contains(Spawn)) {
+		++RespawnStats.Cancelled;
+	}
+	RespawnIds.Add(Spawn, Respawn.Id);
+	RespawnWheel.Schedule(Respawn, Delay);
+
+	++RespawnStats.Scheduled;
+	RespawnStats.PeakQueueDepth = FMath::Max(RespawnStats.PeakQueueDepth, GetRespawnQueueDepth());
+}
+
+void UItemSpawnSubsystem::CancelRespawn(AItemSpawn* Spawn)
+{
+	//the wheel entry stays and is skipped when it expires
+	if (RespawnIds.Remove(Spawn) > 0) {
+		++RespawnStats.Cancelled;
+	}
+}
+
+void UItemSpawnSubsystem::ProcessRespawns(const float DeltaTime)
+{
+	RespawnWheel.Advance(DeltaTime, ReadyRespawns);
+
+	const float TimeSeconds = GetWorld()->GetTimeSeconds();
+	int32 NumRespawned = 0;
+	while (ReadyRespawnsHead < ReadyRespawns.Num() && NumRespawned < MaxRespawnsPerFrame) {
+		const FScheduledRespawn Respawn = ReadyRespawns[ReadyRespawnsHead++];
+
+		//skip respawns that were cancelled or replaced by a newer one
+		const uint32* CurrentId = RespawnIds.Find(Respawn.Spawn);
+		if (!CurrentId || *CurrentId != Respawn.Id) {
+			continue;
+		}
+		RespawnIds.Remove(Respawn.Spawn);
+
+		if (IsValid(Respawn.Spawn)) {
+			Respawn.Spawn->SpawnItem();
+			++NumRespawned;
+
+			const float Latency = FMath::Max(TimeSeconds - Respawn.DueTime, 0.f);
+			++RespawnStats.Spawned;
+			RespawnStats.TotalLatency += Latency;
+			RespawnStats.MaxLatency = FMath::Max(RespawnStats.MaxLatency, Latency);
+		}
+	}
+
+	if (ReadyRespawnsHead >= ReadyRespawns.Num()) {
+		ReadyRespawns.Reset();
+		ReadyRespawnsHead = 0;
+	}
+	else if (ReadyRespawnsHead > ReadyRespawns.Num() / 2) {
+		ReadyRespawns.RemoveAt(0, ReadyRespawnsHead, false);
+		ReadyRespawnsHead = 0;
+	}
+}
+
+void UItemSpawnSubsystem::UpdateActiveSpawns()
+{
+	TArray<FVector> PlayerLocations;
+	GetPlayerLocations(PlayerLocations);
+
+	//only a few players, so check active spawns against every player instead of going through the grid
+	const float DeactivationRadiusSquared = FMath::Square(DeactivationRadius);
+	for (int32 i = ActiveSpawns.Num() - 1; i >= 0; --i) {
+		AItemSpawn* Spawn = ActiveSpawns[i];
+		const FVector SpawnLocation = SpawnLocations.FindRef(Spawn);
+
+		const bool bPlayerNear = PlayerLocations.ContainsByPredicate([&](const FVector& PlayerLocation) {
+			return FVector::DistSquared2D(PlayerLocation, SpawnLocation) <= DeactivationRadiusSquared;
+		});
+
+		if (!bPlayerNear) {
+			ActiveSpawns.RemoveAtSwap(i);
+			if (IsValid(Spawn)) {
+				Spawn->DeactivateSpawn();
+			}
+		}
+	}
+
+	for (const FVector& PlayerLocation : PlayerLocations) {
+		SpawnGrid.ForEachInRadius(PlayerLocation, ActivationRadius, [this](AItemSpawn* Spawn, const FVector&) {
+			if (IsValid(Spawn) && !Spawn->IsSpawnActive()) {
+				ActiveSpawns.Add(Spawn);
+				Spawn->ActivateSpawn();
+			}
+		});
+	}
+}
+
+void UItemSpawnSubsystem::GetPlayerLocations(TArray<FVector>& OutLocations) const
+{
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It) {
+		if (APlayerController* PC = It->Get()) {
+			if (APawn* Pawn = PC->GetPawnOrSpectator()) {
+				OutLocations.Add(Pawn->GetActorLocation());
+			}
+		}
+	}
+}
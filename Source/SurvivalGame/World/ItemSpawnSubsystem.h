@@ -0,0 +1,135 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "World/SpatialGrid.h"
+#include "World/TimingWheel.h"
+#include "ItemSpawnSubsystem.generated.h"
+
+class AItemSpawn;
+
+/** Respawn scheduler counters, useful to check respawns keep up with the spawn budget */
+struct FItemRespawnStats {
+	int32 Scheduled = 0;
+	int32 Spawned = 0;
+	/** respawns dropped because the spawn point was rescheduled or went away */
+	int32 Cancelled = 0;
+	int32 PeakQueueDepth = 0;
+	/** seconds respawns ran late because of the tick resolution and spawn budget */
+	float TotalLatency = 0.f;
+	float MaxLatency = 0.f;
+};
+
+/**
+ * Server side manager of item spawn points. Spawn points are kept in a spatial grid, and only the ones a player comes near
+ * get their pickups spawned in. When every player moved away again, the untouched pickups are despawned and the spawn point remembers what it had.
+ * Deactivation uses a larger radius than activation so walking along the edge doesn't spawn and despawn pickups over and over.
+ * Respawns of every spawn point go through one timing wheel instead of a timer each, and are spread over frames by a spawn budget.
+ * At map load, the loot of every spawn point and of chests that aren't on demand is rolled in parallel before their BeginPlay (see Survival.ParallelLootPreRoll).
+ */
+UCLASS(Config = Game)
+class SURVIVALGAME_API UItemSpawnSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UItemSpawnSubsystem();
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Start managing the spawn point. Its pickups spawn once a player is near */
+	void RegisterSpawn(AItemSpawn* Spawn);
+
+	/** Stop managing the spawn point, ie when it's destroyed */
+	void UnregisterSpawn(AItemSpawn* Spawn);
+
+	/** Check players against spawn points now instead of waiting for the next update */
+	void UpdateActiveSpawns();
+
+	/** Roll new loot for the spawn point after the delay. Replaces a respawn already scheduled for it */
+	void ScheduleRespawn(AItemSpawn* Spawn, const float Delay);
+
+	void CancelRespawn(AItemSpawn* Spawn);
+
+	FORCEINLINE int32 GetNumSpawns() const { return SpawnGrid.Num(); }
+	FORCEINLINE int32 GetNumActiveSpawns() const { return ActiveSpawns.Num(); }
+
+	/** Get how many respawns are waiting, either for their time or for spawn budget. Cancelled ones count until they come up */
+	FORCEINLINE int32 GetRespawnQueueDepth() const { return RespawnWheel.Num() + ReadyRespawns.Num() - ReadyRespawnsHead; }
+
+	FORCEINLINE const FItemRespawnStats& GetRespawnStats() const { return RespawnStats; }
+
+protected:
+	/** spawn points within this distance of a player spawn their pickups */
+	UPROPERTY(Config)
+	float ActivationRadius;
+
+	/** spawn points with no player within this distance despawn their pickups. Should be larger than ActivationRadius */
+	UPROPERTY(Config)
+	float DeactivationRadius;
+
+	/** size of a spatial grid cell. Around the activation radius keeps queries to a few cells */
+	UPROPERTY(Config)
+	float GridCellSize;
+
+	/** seconds between proximity checks */
+	UPROPERTY(Config)
+	float UpdateInterval;
+
+	/** max spawn points respawned per frame. The rest wait for the next frame */
+	UPROPERTY(Config)
+	int32 MaxRespawnsPerFrame;
+
+	/** resolution of respawn times in seconds */
+	UPROPERTY(Config)
+	float RespawnTickInterval;
+
+	UPROPERTY(Transient)
+	TArray<AItemSpawn*> ActiveSpawns;
+
+	TSpatialHashGrid<AItemSpawn*> SpawnGrid;
+
+	/** where each spawn point was added to the grid, needed to remove it again */
+	TMap<AItemSpawn*, FVector> SpawnLocations;
+
+	float TimeSinceUpdate;
+
+	struct FScheduledRespawn {
+		AItemSpawn* Spawn = nullptr;
+		/** matched against RespawnIds, so a cancelled or replaced respawn is skipped when it expires */
+		uint32 Id = 0;
+		float DueTime = 0.f;
+	};
+
+	THierarchicalTimingWheel<FScheduledRespawn> RespawnWheel;
+
+	/** expired respawns waiting for spawn budget, oldest first from ReadyRespawnsHead */
+	TArray<FScheduledRespawn> ReadyRespawns;
+	int32 ReadyRespawnsHead;
+
+	/** id of the respawn currently scheduled for each spawn point */
+	TMap<AItemSpawn*, uint32> RespawnIds;
+
+	uint32 NextRespawnId;
+
+	FItemRespawnStats RespawnStats;
+
+	void ProcessRespawns(const float DeltaTime);
+
+	/** Roll the loot of every spawn point and chest that isn't on demand on worker threads, and hand the results to them */
+	void PreRollLoot(UWorld& InWorld);
+
+	/** when the world began play, to report how long until the map was ready */
+	double MapBeginPlayTime;
+
+	bool bReportMapReady;
+
+	/** Get the locations of every player, or their spectator if they have no pawn */
+	void GetPlayerLocations(TArray<FVector>& OutLocations) const;
+};
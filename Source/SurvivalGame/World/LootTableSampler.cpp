@@ -0,0 +1,287 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "World/LootTableSampler.h"
+#include "World/ItemSpawn.h"
+#include "Engine/DataTable.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+
+namespace LootTableSampler
+{
+	/** made up table with a long tail of rare rows, like our real loot tables */
+	TArray<float> MakeTestWeights(const int32 NumRows)
+	{
+		FRandomStream Stream(42);
+		TArray<float> Weights;
+		for (int32 i = 0; i < NumRows; ++i) {
+			Weights.Add(i % 4 == 0 ? Stream.FRandRange(0.001f, 0.01f) : Stream.FRandRange(0.01f, 1.f));
+		}
+		return Weights;
+	}
+
+	/** how loot used to be rolled: pick any row, reroll until the roll is under its probability */
+	int32 RejectionSample(const TArray<float>& Weights, FRandomStream& Stream)
+	{
+		int32 Index = Stream.RandRange(0, Weights.Num() - 1);
+		while (Stream.GetFraction() > Weights[Index]) {
+			Index = Stream.RandRange(0, Weights.Num() - 1);
+		}
+		return Index;
+	}
+
+	/** Result of comparing the alias sampler with the old reroll sampling */
+	struct FChiSquareResult {
+		double ChiSquare = 0.0;
+		int32 DegreesOfFreedom = 0;
+		/** 99.9th percentile for the degrees of freedom. A chi-square above it means the samplers draw differently */
+		double CriticalValue = 0.0;
+	};
+
+	/** Two sample chi-square test of draws of the alias sampler against draws of the old reroll sampling, with a fixed seed */
+	FChiSquareResult ChiSquareTest(const FLootTableSampler& Sampler, const TArray<float>& Weights, const int32 NumDraws, const int32 Seed)
+	{
+		//expected counts come from the old reroll sampling, so a pass means drops didn't change
+		FRandomStream Stream(Seed);
+		TArray<int32> AliasCounts;
+		TArray<int32> RejectionCounts;
+		AliasCounts.SetNumZeroed(Weights.Num());
+		RejectionCounts.SetNumZeroed(Weights.Num());
+		for (int32 i = 0; i < NumDraws; ++i) {
+			++AliasCounts[Sampler.SampleIndex(Stream)];
+			++RejectionCounts[RejectionSample(Weights, Stream)];
+		}
+
+		//only rows that showed up at all count
+		FChiSquareResult Result;
+		Result.DegreesOfFreedom = -1;
+		for (int32 i = 0; i < Weights.Num(); ++i) {
+			const double Total = AliasCounts[i] + RejectionCounts[i];
+			if (Total > 0.0) {
+				Result.ChiSquare += FMath::Square(double(AliasCounts[i] - RejectionCounts[i])) / Total;
+				++Result.DegreesOfFreedom;
+			}
+		}
+
+		//Wilson-Hilferty approximation of the 99.9th percentile
+		const double K = FMath::Max(Result.DegreesOfFreedom, 1);
+		const double Base = 1.0 - 2.0 / (9.0 * K) + 3.09 * FMath::Sqrt(2.0 / (9.0 * K));
+		Result.CriticalValue = K * Base * Base * Base;
+		return Result;
+	}
+
+	struct FSamplerCacheEntry {
+		TSharedPtr<const FLootTableSampler> Sampler;
+		bool bBoundToChanges = false;
+	};
+
+	TMap<TObjectKey<UDataTable>, FSamplerCacheEntry> SamplerCache;
+}
+
+static FAutoConsoleCommand LootSamplerBenchmarkCommand(
+	TEXT("Survival.LootSamplerBenchmark"),
+	TEXT("Compare draws per second of the alias sampler and the old reroll sampling. Args: [NumDraws=10000000] [NumRows=100]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args) {
+		const int32 NumDraws = FMath::Max(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10000000, 1);
+		const int32 NumRows = FMath::Max(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 100, 1);
+
+		const TArray<float> Weights = LootTableSampler::MakeTestWeights(NumRows);
+		const FLootTableSampler Sampler(Weights);
+
+		FRandomStream Stream(7);
+		int64 Checksum = 0;
+
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 i = 0; i < NumDraws; ++i) {
+			Checksum += Sampler.SampleIndex(Stream);
+		}
+		const double AliasTime = FMath::Max(FPlatformTime::Seconds() - StartTime, SMALL_NUMBER);
+
+		StartTime = FPlatformTime::Seconds();
+		for (int32 i = 0; i < NumDraws; ++i) {
+			Checksum += LootTableSampler::RejectionSample(Weights, Stream);
+		}
+		const double RejectionTime = FMath::Max(FPlatformTime::Seconds() - StartTime, SMALL_NUMBER);
+
+		UE_LOG(LogTemp, Log, TEXT("Loot sampling of %d rows: alias %.2f million draws/sec, reroll %.2f million draws/sec (checksum %lld)"),
+			NumRows, NumDraws / AliasTime / 1000000.0, NumDraws / RejectionTime / 1000000.0, Checksum);
+	}));
+
+static FAutoConsoleCommand LootSamplerChiSquareCommand(
+	TEXT("Survival.LootSamplerChiSquare"),
+	TEXT("Chi-square test of the alias sampler against the old reroll sampling. Args: [NumDraws=1000000] [LootTablePath]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args) {
+		const int32 NumDraws = FMath::Max(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000000, 1);
+
+		TArray<float> Weights;
+		if (Args.Num() > 1) {
+			if (const UDataTable* LootTable = LoadObject<UDataTable>(nullptr, *Args[1])) {
+				TArray<FLootTableRow*> Rows;
+				LootTable->GetAllRows("", Rows);
+				for (const FLootTableRow* Row : Rows) {
+					Weights.Add(Row->Probability);
+				}
+			}
+			else {
+				UE_LOG(LogTemp, Warning, TEXT("Couldn't load loot table %s"), *Args[1]);
+				return;
+			}
+		}
+		else {
+			Weights = LootTableSampler::MakeTestWeights(20);
+		}
+
+		const FLootTableSampler Sampler(Weights);
+		if (Sampler.Num() == 0) {
+			UE_LOG(LogTemp, Warning, TEXT("Loot table has nothing to draw"));
+			return;
+		}
+
+		const LootTableSampler::FChiSquareResult Result = LootTableSampler::ChiSquareTest(Sampler, Weights, NumDraws, 11);
+
+		UE_LOG(LogTemp, Log, TEXT("Loot sampler chi-square: %.2f with %d degrees of freedom, critical value %.2f at 0.1%%: %s"),
+			Result.ChiSquare, Result.DegreesOfFreedom, Result.CriticalValue, Result.ChiSquare <= Result.CriticalValue ? TEXT("PASS") : TEXT("FAIL"));
+	}));
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLootSamplerChiSquareTest, "SurvivalGame.Loot.SamplerMatchesRerollSampling", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FLootSamplerChiSquareTest::RunTest(const FString& Parameters)
+{
+	const TArray<float> Weights = LootTableSampler::MakeTestWeights(20);
+	const FLootTableSampler Sampler(Weights);
+	TestEqual(TEXT("Sampler has a slot per row"), Sampler.Num(), Weights.Num());
+
+	//fixed seed, so the test gives the same answer every run
+	const LootTableSampler::FChiSquareResult Result = LootTableSampler::ChiSquareTest(Sampler, Weights, 1000000, 11);
+	TestTrue(FString::Printf(TEXT("Chi-square %.2f with %d degrees of freedom is within the critical value %.2f"), Result.ChiSquare, Result.DegreesOfFreedom, Result.CriticalValue),
+		Result.ChiSquare <= Result.CriticalValue);
+
+	return true;
+}
+
+#endif
+
+FLootTableSampler::FLootTableSampler(const TArray<float>& Weights)
+{
+	const int32 NumWeights = Weights.Num();
+
+	double TotalWeight = 0.0;
+	for (const float Weight : Weights) {
+		TotalWeight += FMath::Max(Weight, 0.f);
+	}
+
+	if (NumWeights == 0 || TotalWeight <= 0.0) {
+		return;
+	}
+
+	Probabilities.SetNumUninitialized(NumWeights);
+	KeepChances.SetNumUninitialized(NumWeights);
+	Aliases.SetNumUninitialized(NumWeights);
+
+	//scale so the average slot holds exactly one
+	TArray<double> Scaled;
+	Scaled.SetNumUninitialized(NumWeights);
+	TArray<int32> Small;
+	TArray<int32> Large;
+	for (int32 i = 0; i < NumWeights; ++i) {
+		Probabilities[i] = FMath::Max(Weights[i], 0.f) / TotalWeight;
+		Scaled[i] = Probabilities[i] * NumWeights;
+		Aliases[i] = i;
+
+		if (Scaled[i] < 1.0) {
+			Small.Add(i);
+		}
+		else {
+			Large.Add(i);
+		}
+	}
+
+	//fill every small slot up to one with a piece of a large one
+	while (Small.Num() > 0 && Large.Num() > 0) {
+		const int32 SmallIndex = Small.Pop(false);
+		const int32 LargeIndex = Large.Pop(false);
+
+		KeepChances[SmallIndex] = Scaled[SmallIndex];
+		Aliases[SmallIndex] = LargeIndex;
+
+		Scaled[LargeIndex] = (Scaled[LargeIndex] + Scaled[SmallIndex]) - 1.0;
+		if (Scaled[LargeIndex] < 1.0) {
+			Small.Add(LargeIndex);
+		}
+		else {
+			Large.Add(LargeIndex);
+		}
+	}
+
+	//whatever is left is one up to rounding errors
+	for (const int32 Index : Large) {
+		KeepChances[Index] = 1.f;
+	}
+	for (const int32 Index : Small) {
+		KeepChances[Index] = 1.f;
+	}
+}
+
+TSharedPtr<const FLootTableSampler> FLootTableSampler::Get(UDataTable* LootTable)
+{
+	if (!LootTable || LootTable->GetRowStruct() == nullptr || !LootTable->GetRowStruct()->IsChildOf(FLootTableRow::StaticStruct())) {
+		return nullptr;
+	}
+
+	const TObjectKey<UDataTable> LootTableKey(LootTable);
+	LootTableSampler::FSamplerCacheEntry& Entry = LootTableSampler::SamplerCache.FindOrAdd(LootTableKey);
+
+	if (!Entry.bBoundToChanges) {
+		LootTable->OnDataTableChanged().AddStatic(&FLootTableSampler::Invalidate, LootTableKey);
+		Entry.bBoundToChanges = true;
+	}
+
+	if (!Entry.Sampler.IsValid()) {
+		TArray<FLootTableRow*> LootRows;
+		LootTable->GetAllRows("", LootRows);
+
+		TArray<float> Weights;
+		for (const FLootTableRow* LootRow : LootRows) {
+			Weights.Add(LootRow->Probability);
+		}
+
+		TSharedPtr<FLootTableSampler> Sampler = MakeShared<FLootTableSampler>(Weights);
+		if (Sampler->Num() > 0) {
+			Sampler->Rows.Append(LootRows);
+			Entry.Sampler = Sampler;
+		}
+	}
+
+	return Entry.Sampler;
+}
+
+int32 FLootTableSampler::SampleIndex(const float SlotRoll, const float AliasRoll) const
+{
+	if (Aliases.Num() == 0) {
+		return INDEX_NONE;
+	}
+
+	const int32 Slot = FMath::Min(FMath::FloorToInt(SlotRoll * Aliases.Num()), Aliases.Num() - 1);
+	return AliasRoll < KeepChances[Slot] ? Slot : Aliases[Slot];
+}
+
+const FLootTableRow* FLootTableSampler::Sample(FRandomStream& Stream) const
+{
+	const int32 Index = SampleIndex(Stream);
+	return Rows.IsValidIndex(Index) ? Rows[Index] : nullptr;
+}
+
+const FLootTableRow* FLootTableSampler::Sample() const
+{
+	const int32 Index = SampleIndex();
+	return Rows.IsValidIndex(Index) ? Rows[Index] : nullptr;
+}
+
+void FLootTableSampler::Invalidate(TObjectKey<UDataTable> LootTableKey)
+{
+	if (LootTableSampler::FSamplerCacheEntry* Entry = LootTableSampler::SamplerCache.Find(LootTableKey)) {
+		Entry->Sampler.Reset();
+	}
+}
@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UDataTable;
+struct FLootTableRow;
+
+/**
+ * Draws rows of a loot table in constant time with Vose's alias method.
+ * Rows are picked with chance Probability / sum of all probabilities, the same distribution as picking a random row
+ * and rerolling until a roll is under its Probability, without the rerolls.
+ * Samplers are built once per data table and shared, and rebuilt when the table changes.
+ */
+class SURVIVALGAME_API FLootTableSampler
+{
+public:
+	/** Build alias tables for the weights. Weights don't need to add up to one */
+	explicit FLootTableSampler(const TArray<float>& Weights);
+
+	/**
+	 * Get the shared sampler of the loot table, building it the first time. Null if the table has no rows with a chance to drop.
+	 * Game thread only, but the sampler itself never changes, so it can be sampled from any thread with a stream of its own
+	 */
+	static TSharedPtr<const FLootTableSampler> Get(UDataTable* LootTable);
+
+	/** Draw a row index from two uniform numbers in [0, 1) */
+	int32 SampleIndex(const float SlotRoll, const float AliasRoll) const;
+
+	int32 SampleIndex(FRandomStream& Stream) const
+	{
+		//two statements, argument evaluation order isn't defined and seeded loot must draw the same on every compiler
+		const float SlotRoll = Stream.GetFraction();
+		return SampleIndex(SlotRoll, Stream.GetFraction());
+	}
+	int32 SampleIndex() const { return SampleIndex(FMath::FRand(), FMath::FRand()); }
+
+	/** Draw a row. Only valid for samplers of a loot table */
+	const FLootTableRow* Sample(FRandomStream& Stream) const;
+	const FLootTableRow* Sample() const;
+
+	int32 Num() const { return Aliases.Num(); }
+
+	/** Get the chance of drawing the index */
+	float GetProbability(const int32 Index) const { return Probabilities.IsValidIndex(Index) ? Probabilities[Index] : 0.f; }
+
+	const TArray<float>& GetKeepChances() const { return KeepChances; }
+	const TArray<int32>& GetAliases() const { return Aliases; }
+
+private:
+	/** chance of keeping the slot instead of taking its alias */
+	TArray<float> KeepChances;
+	TArray<int32> Aliases;
+
+	/** normalized weights, for tests */
+	TArray<float> Probabilities;
+
+	/** rows of the loot table in index order, owned by the table */
+	TArray<const FLootTableRow*> Rows;
+
+	/** drop the cached sampler of a table that was changed or reimported */
+	static void Invalidate(TObjectKey<UDataTable> LootTableKey);
+};
@@ -7,9 +7,146 @@
 #include "Engine/DataTable.h"
 #include "Items/Item.h"
 #include "World/ItemSpawn.h"
+#include "World/LootTableSampler.h"
+#include "World/CookedLootTable.h"
 #include "Player/SurvivalCharacter.h"
+#include "GameFramework/PlayerController.h"
+#include "Net/UnrealNetwork.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+#include "Engine/World.h"
+#include "Items/FoodItem.h"
+#include "Items/AmmoItem.h"
+#include "Items/ClothingItem.h"
+#endif
 
 #define LOCTEXT_NAMESPACE "LootableChest"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSeededLootTest, "SurvivalGame.Loot.SeededChestContents", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FSeededLootTest::RunTest(const FString& Parameters)
+{
+	const int32 NumSeeds = 200;
+
+	//item defaults that run into every inventory rule: full stacks, weight running out in the middle of a stack, unstackable items and capacity
+	struct FTestItemDefaults {
+		UItem* Item;
+		float Weight;
+		int32 Quantity;
+		int32 MaxStackSize;
+	};
+	TArray<FTestItemDefaults> TestItems = {
+		{ GetMutableDefault<UFoodItem>(), 3.f, 2, 5 },
+		{ GetMutableDefault<UAmmoItem>(), 0.25f, 12, 30 },
+		{ GetMutableDefault<UClothingItem>(), 6.f, 1, 1 }
+	};
+	for (FTestItemDefaults& TestItem : TestItems) {
+		Swap(TestItem.Item->Weight, TestItem.Weight);
+		Swap(TestItem.Item->Quantity, TestItem.Quantity);
+		Swap(TestItem.Item->MaxStackSize, TestItem.MaxStackSize);
+	}
+
+	UDataTable* LootTable = NewObject<UDataTable>(GetTransientPackage());
+	LootTable->RowStruct = FLootTableRow::StaticStruct();
+	FLootTableRow Row;
+	Row.Items = { UFoodItem::StaticClass() };
+	Row.Probability = 1.f;
+	LootTable->AddRow(TEXT("Food"), Row);
+	Row.Items = { UAmmoItem::StaticClass(), UAmmoItem::StaticClass() };
+	Row.Probability = 0.5f;
+	LootTable->AddRow(TEXT("Ammo"), Row);
+	Row.Items = { UClothingItem::StaticClass(), UFoodItem::StaticClass() };
+	Row.Probability = 0.25f;
+	LootTable->AddRow(TEXT("Clothing"), Row);
+
+	TSharedPtr<const FLootTableSampler> LootSampler = FLootTableSampler::Get(LootTable);
+
+	//world never begins play, so chests don't pick a seed of their own
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+
+	auto SpawnChest = [World, LootTable](const bool bSeeded, const ENetRole Role) {
+		ALootableChest* Chest = World->SpawnActorDeferred<ALootableChest>(ALootableChest::StaticClass(), FTransform::Identity);
+		Chest->LootTable = LootTable;
+		Chest->LootRolls = FIntPoint(4, 24);
+		Chest->UntouchedLootLifetime = 0.f;
+		Chest->bReplicateLootBySeed = bSeeded;
+		Chest->SetRole(Role);
+		Chest->FinishSpawning(FTransform::Identity);
+		return Chest;
+	};
+
+	auto ContentsMatch = [](const TArray<FRolledItem>& A, const TArray<FRolledItem>& B) {
+		bool bMatch = A.Num() == B.Num();
+		for (int32 i = 0; bMatch && i < A.Num(); ++i) {
+			bMatch = A[i].ItemClass == B[i].ItemClass && A[i].Quantity == B[i].Quantity;
+		}
+		return bMatch;
+	};
+
+	FRandomStream TakeStream(7);
+	for (int32 Seed = 0; Seed < NumSeeds; ++Seed) {
+		//reference is the items of the same rows added one by one to a real inventory, like chests did before loot was rolled into stacks
+		ALootableChest* Reference = SpawnChest(false, ROLE_Authority);
+		FRandomStream LootStream(Seed);
+		const int32 Rolls = LootStream.RandRange(Reference->LootRolls.GetMin(), Reference->LootRolls.GetMax());
+		for (int32 i = 0; i < Rolls; ++i) {
+			for (const TSubclassOf<UItem>& ItemClass : LootSampler->Sample(LootStream)->Items) {
+				Reference->Inventory->TryAddItemFromClass(ItemClass, ItemClass->GetDefaultObject<UItem>()->GetQuantity());
+			}
+		}
+
+		TArray<FRolledItem> ReferenceContents;
+		Reference->GetInventoryContents(ReferenceContents);
+
+		TArray<FRolledItem> Rolled;
+		ALootableChest::RollLootContents(LootTable, Reference->LootRolls, Seed, Reference->Inventory->GetCapacity(), Reference->Inventory->GetWeightCapacity(), Rolled);
+		TestTrue(FString::Printf(TEXT("Seed %d rolls the same stacks as TryAddItem"), Seed), ContentsMatch(Rolled, ReferenceContents));
+
+		//server opens a seeded chest and players take random amounts of any stack, the way ASurvivalCharacter::LootItem does on a listen server
+		ALootableChest* Server = SpawnChest(true, ROLE_Authority);
+		Server->LootSeed = Seed;
+		UInventoryComponent* ServerInventory = Server->GetLootInventory();
+
+		const int32 NumTakes = TakeStream.RandRange(0, ServerInventory->GetItems().Num());
+		for (int32 i = 0; i < NumTakes && ServerInventory->GetItems().Num() > 0; ++i) {
+			const TArray<UItem*> Items = ServerInventory->GetItems();
+			UItem* Item = Items[TakeStream.RandRange(0, Items.Num() - 1)];
+			Server->TakeItem(Item, TakeStream.RandRange(1, Item->GetQuantity()));
+		}
+
+		//client only gets what replication sends
+		ALootableChest* Client = SpawnChest(true, ROLE_SimulatedProxy);
+		Client->LootSeed = Server->LootSeed;
+		Client->TakenItems = Server->TakenItems;
+		Client->GetLootInventory();
+
+		TArray<FRolledItem> ServerContents;
+		TArray<FRolledItem> ClientContents;
+		Server->GetInventoryContents(ServerContents);
+		Client->GetInventoryContents(ClientContents);
+		TestTrue(FString::Printf(TEXT("Seed %d client rebuilds the server contents"), Seed), ContentsMatch(ServerContents, ClientContents));
+
+		Reference->Destroy();
+		Server->Destroy();
+		Client->Destroy();
+	}
+
+	World->DestroyWorld(false);
+
+	for (FTestItemDefaults& TestItem : TestItems) {
+		Swap(TestItem.Item->Weight, TestItem.Weight);
+		Swap(TestItem.Item->Quantity, TestItem.Quantity);
+		Swap(TestItem.Item->MaxStackSize, TestItem.MaxStackSize);
+	}
+
+	return true;
+}
+
+#endif
+
 // Sets default values
 ALootableChest::ALootableChest()
 {
@@ -26,6 +163,15 @@ ALootableChest::ALootableChest()
 	Inventory->SetWeightCapacity(80.f);
 
 	LootRolls = FIntPoint(2, 8);
+	bGenerateLootOnDemand = true;
+	UntouchedLootLifetime = 300.f;
+	bReplicateLootBySeed = false;
+
+	LootSeed = 0;
+	bLootGenerated = false;
+	bLootPreRolled = false;
+	bLocalContentsBuilt = false;
+	GeneratedContentsChecksum = 0;
 
 	SetReplicates(true);
 }
@@ -37,40 +183,339 @@ void ALootableChest::BeginPlay()
 	
 	LootInteraction->OnInteract.AddDynamic(this, &ALootableChest::OnInteract);
 
-	if (HasAuthority() && LootTable) {
-		TArray<FLootTableRow*> SpawnItems;
-		LootTable->GetAllRows("", SpawnItems);
+	if (HasAuthority()) {
+		if (!bLootPreRolled) {
+			LootSeed = FMath::Rand();
+		}
 
-		int32 Rolls = FMath::RandRange(LootRolls.GetMin(), LootRolls.GetMax());
+		//most chests are never opened, don't create their items until someone does
+		if (!bGenerateLootOnDemand) {
+			GenerateLoot();
+		}
+	}
+}
 
-		for (int32 i = 0; i < Rolls; ++i) {
-			const FLootTableRow* LootRow = SpawnItems[FMath::RandRange(0, SpawnItems.Num() - 1)];
+void ALootableChest::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
 
-			ensure(LootRow);
+	//clients build the items themselves, don't send them
+	if (bReplicateLootBySeed) {
+		Inventory->SetIsReplicated(false);
+	}
+}
 
-			float ProbabilityRoll = FMath::FRandRange(0.f, 1.f);
-			while (ProbabilityRoll > LootRow->Probability) {
-				LootRow = SpawnItems[FMath::RandRange(0, SpawnItems.Num() - 1)];
-				ProbabilityRoll = FMath::FRandRange(0.f, 1.f);
+void ALootableChest::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME_CONDITION(ALootableChest, LootSeed, COND_Custom);
+	DOREPLIFETIME_CONDITION(ALootableChest, TakenItems, COND_Custom);
+}
+
+void ALootableChest::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	Super::PreReplication(ChangedPropertyTracker);
+
+	//the seed gives away the contents, only send it to clients that have to roll them
+	DOREPLIFETIME_ACTIVE_OVERRIDE(ALootableChest, LootSeed, bReplicateLootBySeed);
+	DOREPLIFETIME_ACTIVE_OVERRIDE(ALootableChest, TakenItems, bReplicateLootBySeed);
+}
+
+void ALootableChest::OnInteract(class ASurvivalCharacter* Character)
+{
+	if (Character) {
+		Character->SetLootSource(GetLootInventory());
+	}
+}
+
+UInventoryComponent* ALootableChest::GetLootInventory()
+{
+	if (HasAuthority()) {
+		GenerateLoot();
+	}
+	else if (bReplicateLootBySeed && !bLocalContentsBuilt) {
+		BuildLocalContents();
+	}
+	return Inventory;
+}
+
+void ALootableChest::NotifyContentsChanged()
+{
+	if (HasAuthority() && bLootGenerated && bReplicateLootBySeed) {
+		TArray<FRolledItem> Contents;
+		GetInventoryContents(Contents);
+		GetTakenItems(GeneratedContents, Contents, TakenItems);
+	}
+}
+
+int32 ALootableChest::TakeItem(class UItem* Item, const int32 Quantity)
+{
+	if (!Item) {
+		return 0;
+	}
+
+	int32 Taken = 0;
+	if (bReplicateLootBySeed) {
+		//clients only get how much of a class was taken and remove it from the first stacks(RemoveTakenItems), so take from the same stacks
+		while (Taken < Quantity) {
+			UItem* Stack = Inventory->FindItemByClass(Item->GetClass());
+			const int32 Consumed = Stack ? Inventory->ConsumeItem(Stack, Quantity - Taken) : 0;
+			if (Consumed <= 0) {
+				break;
 			}
+			Taken += Consumed;
+		}
+	}
+	else {
+		Taken = Inventory->ConsumeItem(Item, Quantity);
+	}
+
+	NotifyContentsChanged();
+	return Taken;
+}
 
-			if (LootRow && LootRow->Items.Num()) {
-				for (auto& ItemClass : LootRow->Items) {
-					if (ItemClass) {
-						const int32 Quantity = Cast<UItem>(ItemClass->GetDefaultObject())->GetQuantity();
-						Inventory->TryAddItemFromClass(ItemClass, Quantity);
-					}
-				}
+void ALootableChest::OnRep_LootContents()
+{
+	//contents are only built once someone looks at them
+	if (bReplicateLootBySeed && bLocalContentsBuilt) {
+		BuildLocalContents();
+	}
+}
+
+void ALootableChest::BuildLocalContents()
+{
+	bLocalContentsBuilt = true;
+
+	TArray<FRolledItem> Contents;
+	RollContents(Contents);
+	RemoveTakenItems(Contents, TakenItems);
+
+	Inventory->ClearItems();
+	for (const FRolledItem& RolledItem : Contents) {
+		Inventory->AddItemUnchecked(RolledItem.ItemClass, RolledItem.Quantity);
+	}
+	Inventory->OnInventoryUpdated.Broadcast();
+}
+
+void ALootableChest::GenerateLoot()
+{
+	if (bLootGenerated) {
+		return;
+	}
+	bLootGenerated = true;
+
+	//same seed rolls the same loot, so lazy and discarded chests come back with what they'd have had anyway, and seeded chests' clients can roll it too
+	if (!bLootPreRolled) {
+		RollContents(GeneratedContents);
+	}
+	bLootPreRolled = false;
+
+	for (const FRolledItem& RolledItem : GeneratedContents) {
+		Inventory->AddItemUnchecked(RolledItem.ItemClass, RolledItem.Quantity);
+	}
+	TakenItems.Reset();
+
+	if (bGenerateLootOnDemand && UntouchedLootLifetime > 0.f && (LootTable || CookedLootTable)) {
+		GeneratedContentsChecksum = GetContentsChecksum();
+		GetWorldTimerManager().SetTimer(TimerHandle_DiscardLoot, this, &ALootableChest::DiscardUntouchedLoot, UntouchedLootLifetime, false);
+	}
+}
+
+void ALootableChest::DiscardUntouchedLoot()
+{
+	//someone took or added something, it's theirs to keep now
+	if (GetContentsChecksum() != GeneratedContentsChecksum) {
+		return;
+	}
+
+	//still open in someone's loot window, check again later
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It) {
+		APlayerController* PC = It->Get();
+		const ASurvivalCharacter* Character = PC ? Cast<ASurvivalCharacter>(PC->GetPawn()) : nullptr;
+		if (Character && Character->GetLootSource() == Inventory) {
+			GetWorldTimerManager().SetTimer(TimerHandle_DiscardLoot, this, &ALootableChest::DiscardUntouchedLoot, UntouchedLootLifetime, false);
+			return;
+		}
+	}
+
+	for (UItem* Item : Inventory->GetItems()) {
+		Inventory->RemoveItem(Item);
+	}
+	GeneratedContents.Reset();
+	bLootGenerated = false;
+}
+
+void ALootableChest::SetPreRolledLoot(const int32 Seed, TArray<FRolledItem>&& Contents)
+{
+	if (HasAuthority() && !bLootGenerated) {
+		LootSeed = Seed;
+		GeneratedContents = MoveTemp(Contents);
+		bLootPreRolled = true;
+	}
+}
+
+void ALootableChest::RollLootContents(UDataTable* LootTable, const FIntPoint& LootRolls, const int32 Seed, const int32 Capacity, const float WeightCapacity, TArray<FRolledItem>& OutContents)
+{
+	TSharedPtr<const FLootTableSampler> LootSampler = FLootTableSampler::Get(LootTable);
+	if (LootSampler.IsValid()) {
+		RollLootContents(*LootSampler, LootRolls, Seed, Capacity, WeightCapacity, OutContents);
+	}
+	else {
+		OutContents.Reset();
+	}
+}
+
+void ALootableChest::RollLootContents(const FLootTableSampler& LootSampler, const FIntPoint& LootRolls, const int32 Seed, const int32 Capacity, const float WeightCapacity, TArray<FRolledItem>& OutContents)
+{
+	OutContents.Reset();
+
+	FRandomStream LootStream(Seed);
+	float Weight = 0.f;
+
+	const int32 Rolls = LootStream.RandRange(LootRolls.GetMin(), LootRolls.GetMax());
+	for (int32 i = 0; i < Rolls; ++i) {
+		const FLootTableRow* LootRow = LootSampler.Sample(LootStream);
+
+		ensure(LootRow);
+
+		if (!LootRow) {
+			continue;
+		}
+
+		for (auto& ItemClass : LootRow->Items) {
+			AddRolledItem(ItemClass, Capacity, WeightCapacity, Weight, OutContents);
+		}
+	}
+}
+
+void ALootableChest::RollLootContents(const UCookedLootTable& CookedLootTable, const FIntPoint& LootRolls, const int32 Seed, const int32 Capacity, const float WeightCapacity, TArray<FRolledItem>& OutContents)
+{
+	OutContents.Reset();
+
+	FRandomStream LootStream(Seed);
+	float Weight = 0.f;
+
+	const int32 Rolls = LootStream.RandRange(LootRolls.GetMin(), LootRolls.GetMax());
+	for (int32 i = 0; i < Rolls; ++i) {
+		const int32 Row = CookedLootTable.SampleRow(LootStream);
+
+		ensure(Row != INDEX_NONE);
+
+		for (const uint16 ItemId : CookedLootTable.GetRowItemIds(Row)) {
+			AddRolledItem(CookedLootTable.GetItemClass(ItemId), Capacity, WeightCapacity, Weight, OutContents);
+		}
+	}
+}
+
+void ALootableChest::AddRolledItem(const TSubclassOf<UItem>& ItemClass, const int32 Capacity, const float WeightCapacity, float& Weight, TArray<FRolledItem>& Contents)
+{
+	const UItem* Item = ItemClass ? ItemClass->GetDefaultObject<UItem>() : nullptr;
+	const int32 Quantity = Item ? FMath::Clamp(Item->GetQuantity(), 0, Item->MaxStackSize) : 0;
+	if (Quantity <= 0) {
+		return;
+	}
+
+	//same checks as UInventoryComponent::TryAddItem, in the same order
+	if (Contents.Num() + 1 > Capacity) {
+		return;
+	}
+	if (!FMath::IsNearlyZero(Item->Weight) && Weight + Item->Weight > WeightCapacity) {
+		return;
+	}
+
+	FRolledItem* ExistingStack = Item->bStackable ? Contents.FindByPredicate([&ItemClass](const FRolledItem& Stack) { return Stack.ItemClass == ItemClass; }) : nullptr;
+	if (ExistingStack) {
+		int32 AddAmount = FMath::Min(Quantity, Item->MaxStackSize - ExistingStack->Quantity);
+		if (!FMath::IsNearlyZero(Item->Weight)) {
+			AddAmount = FMath::Min(AddAmount, FMath::FloorToInt((WeightCapacity - Weight) / Item->Weight));
+		}
+		if (AddAmount > 0) {
+			ExistingStack->Quantity += AddAmount;
+			Weight += AddAmount * Item->Weight;
+		}
+	}
+	else {
+		FRolledItem& NewStack = Contents.AddDefaulted_GetRef();
+		NewStack.ItemClass = ItemClass;
+		NewStack.Quantity = Quantity;
+		Weight += Quantity * Item->Weight;
+	}
+}
+
+void ALootableChest::RollContents(TArray<FRolledItem>& OutContents) const
+{
+	if (CookedLootTable) {
+		RollLootContents(*CookedLootTable, LootRolls, LootSeed, Inventory->GetCapacity(), Inventory->GetWeightCapacity(), OutContents);
+	}
+	else {
+		RollLootContents(LootTable, LootRolls, LootSeed, Inventory->GetCapacity(), Inventory->GetWeightCapacity(), OutContents);
+	}
+}
+
+void ALootableChest::GetTakenItems(const TArray<FRolledItem>& Generated, const TArray<FRolledItem>& Current, TArray<FRolledItem>& OutTaken)
+{
+	OutTaken.Reset();
+
+	for (const FRolledItem& Stack : Generated) {
+		FRolledItem* Taken = OutTaken.FindByPredicate([&Stack](const FRolledItem& Other) { return Other.ItemClass == Stack.ItemClass; });
+		if (!Taken) {
+			Taken = &OutTaken.AddDefaulted_GetRef();
+			Taken->ItemClass = Stack.ItemClass;
+		}
+		Taken->Quantity += Stack.Quantity;
+	}
+
+	for (const FRolledItem& Stack : Current) {
+		if (FRolledItem* Taken = OutTaken.FindByPredicate([&Stack](const FRolledItem& Other) { return Other.ItemClass == Stack.ItemClass; })) {
+			Taken->Quantity -= Stack.Quantity;
+		}
+	}
+
+	OutTaken.RemoveAll([](const FRolledItem& Taken) { return Taken.Quantity <= 0; });
+}
+
+void ALootableChest::RemoveTakenItems(TArray<FRolledItem>& Contents, const TArray<FRolledItem>& Taken)
+{
+	//the server takes from the first stack of a class first (UInventoryComponent::FindItemByClass), do the same
+	for (const FRolledItem& TakenItem : Taken) {
+		int32 Remaining = TakenItem.Quantity;
+		for (FRolledItem& Stack : Contents) {
+			if (Remaining <= 0) {
+				break;
+			}
+			if (Stack.ItemClass == TakenItem.ItemClass) {
+				const int32 Amount = FMath::Min(Stack.Quantity, Remaining);
+				Stack.Quantity -= Amount;
+				Remaining -= Amount;
 			}
 		}
 	}
+
+	Contents.RemoveAll([](const FRolledItem& Stack) { return Stack.Quantity <= 0; });
 }
 
-void ALootableChest::OnInteract(class ASurvivalCharacter* Character)
+void ALootableChest::GetInventoryContents(TArray<FRolledItem>& OutContents) const
 {
-	if (Character) {
-		Character->SetLootSource(Inventory);
+	OutContents.Reset();
+	for (const UItem* Item : Inventory->GetItems()) {
+		if (Item) {
+			FRolledItem& Stack = OutContents.AddDefaulted_GetRef();
+			Stack.ItemClass = Item->GetClass();
+			Stack.Quantity = Item->GetQuantity();
+		}
+	}
+}
+
+uint32 ALootableChest::GetContentsChecksum() const
+{
+	uint32 Checksum = 0;
+	for (const UItem* Item : Inventory->GetItems()) {
+		if (Item) {
+			Checksum = HashCombine(Checksum, HashCombine(GetTypeHash(Item->GetClass()), GetTypeHash(Item->GetQuantity())));
+		}
 	}
+	return Checksum;
 }
 
 #undef LOCTEXT_NAMESPACE 
\ No newline at end of file
@@ -4,12 +4,15 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "World/ItemSpawn.h"
 #include "LootableChest.generated.h"
 
 UCLASS()
 class SURVIVALGAME_API ALootableChest : public AActor
 {
 	GENERATED_BODY()
+
+	friend class FSeededLootTest;
 	
 public:	
 	// Sets default values for this actor's properties
@@ -28,15 +31,116 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Components")
 	class UDataTable* LootTable;
 
+	/** Compiled loot table. Used instead of LootTable when set */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Components")
+	class UCookedLootTable* CookedLootTable;
+
 	/** The number of times to roll the loot table. Random number between min and max will be used. */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Components")
 	FIntPoint LootRolls;
 
+	/** Only pick a seed on begin play, and roll the loot table the first time someone opens the chest or asks for its inventory */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Components")
+	bool bGenerateLootOnDemand;
+
+	/** Seconds generated loot nobody took anything from is kept before it's thrown away, to be rolled again from the seed if needed. Zero keeps it forever */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Components", meta=(EditCondition="bGenerateLootOnDemand"))
+	float UntouchedLootLifetime;
+
+	/** Only replicate the loot seed and what was taken. Clients roll the same contents from the seed themselves instead of receiving every item */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Components")
+	bool bReplicateLootBySeed;
+
+	/** Get the inventory, rolling the loot first if it hasn't been yet. Clients of seeded chests build their local contents here */
+	UFUNCTION(BlueprintCallable, Category="Loot")
+	class UInventoryComponent* GetLootInventory();
+
+	/** [server] Update what was taken since the loot was rolled, so clients of seeded chests can rebuild the contents */
+	void NotifyContentsChanged();
+
+	/**
+	 * [server] Take some of an item out of the chest and return how much was taken.
+	 * Seeded chests take it from the first stacks of the item's class instead, the only stacks their clients know to take from
+	 */
+	int32 TakeItem(class UItem* Item, const int32 Quantity);
+
+	/**
+	 * Roll the loot table into item stacks with the same stacking, capacity and weight rules as adding the items to an inventory one by one.
+	 * The same seed always gives the same contents, on any machine
+	 */
+	static void RollLootContents(UDataTable* LootTable, const FIntPoint& LootRolls, const int32 Seed, const int32 Capacity, const float WeightCapacity, TArray<FRolledItem>& OutContents);
+
+	/** Same, with the sampler of the loot table already at hand. Safe to call off the game thread */
+	static void RollLootContents(const class FLootTableSampler& LootSampler, const FIntPoint& LootRolls, const int32 Seed, const int32 Capacity, const float WeightCapacity, TArray<FRolledItem>& OutContents);
+
+	/** Same, from a compiled loot table. Rolls the same contents as its source table for the same seed. Safe to call off the game thread */
+	static void RollLootContents(const class UCookedLootTable& CookedLootTable, const FIntPoint& LootRolls, const int32 Seed, const int32 Capacity, const float WeightCapacity, TArray<FRolledItem>& OutContents);
+
+	/** [server] Use loot rolled ahead of time from the seed, ie at map load, instead of rolling it when the chest is first opened */
+	void SetPreRolledLoot(const int32 Seed, TArray<FRolledItem>&& Contents);
+
+	/** Get how much of each item class is missing from Current compared to Generated */
+	static void GetTakenItems(const TArray<FRolledItem>& Generated, const TArray<FRolledItem>& Current, TArray<FRolledItem>& OutTaken);
+
+	/** Take the taken quantities away from the contents, dropping stacks that run out */
+	static void RemoveTakenItems(TArray<FRolledItem>& Contents, const TArray<FRolledItem>& Taken);
 
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void PostInitializeComponents() override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
 
 	UFUNCTION()
 	void OnInteract(class ASurvivalCharacter* Character);
+
+	/** [server] Roll the loot table into the inventory if it hasn't been yet */
+	void GenerateLoot();
+
+	/** [server] throw away generated loot if nobody touched it */
+	void DiscardUntouchedLoot();
+
+	/** Get a checksum of the inventory contents, to tell if anything was taken or added */
+	uint32 GetContentsChecksum() const;
+
+	/** Roll the contents of this chest from LootSeed, from the cooked loot table if there is one */
+	void RollContents(TArray<FRolledItem>& OutContents) const;
+
+	/** Add one rolled item to the contents, following the rules of UInventoryComponent::TryAddItem */
+	static void AddRolledItem(const TSubclassOf<class UItem>& ItemClass, const int32 Capacity, const float WeightCapacity, float& Weight, TArray<FRolledItem>& Contents);
+
+	/** Get the stacks currently in the inventory */
+	void GetInventoryContents(TArray<FRolledItem>& OutContents) const;
+
+	/** [client] Roll the contents from the seed, remove what was taken and put the result in the local inventory */
+	void BuildLocalContents();
+
+	UFUNCTION()
+	void OnRep_LootContents();
+
+	/** seed the loot gets rolled from. Only replicated by seeded chests */
+	UPROPERTY(ReplicatedUsing=OnRep_LootContents)
+	int32 LootSeed;
+
+	/** how much of each item class was taken since the loot was rolled. Only used by seeded chests */
+	UPROPERTY(ReplicatedUsing=OnRep_LootContents)
+	TArray<FRolledItem> TakenItems;
+
+	/** [server] contents right after the loot was rolled */
+	UPROPERTY()
+	TArray<FRolledItem> GeneratedContents;
+
+	bool bLootGenerated;
+
+	/** [server] GeneratedContents were rolled ahead of time, but not put in the inventory yet */
+	bool bLootPreRolled;
+
+	/** [client] local contents were built once, so they need rebuilding when the seed or taken items change */
+	bool bLocalContentsBuilt;
+
+	/** contents checksum right after the loot was rolled */
+	uint32 GeneratedContentsChecksum;
+
+	FTimerHandle TimerHandle_DiscardLoot;
 };
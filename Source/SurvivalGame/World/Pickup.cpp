@@ -8,6 +8,9 @@
 #include "Components/StaticMeshComponent.h"
 #include "Components/InteractionComponent.h"
 #include "Components/InventoryComponent.h"
+#include "World/PickupDropSubsystem.h"
+#include "Framework/SceneQuerySubsystem.h"
+#include "Engine/StaticMesh.h"
 #include "Items/Item.h"
 
 // Sets default values
@@ -25,9 +28,14 @@ APickup::APickup()
 	InteractionComponent->InteractableNameText = FText::FromString("Pickup");
 	InteractionComponent->InteractableActionText = FText::FromString("Take");
 	InteractionComponent->OnInteract.AddDynamic(this, &APickup::OnTakePickup);
+	InteractionComponent->OnBeginFocus.AddDynamic(this, &APickup::OnBeginFocus);
+	InteractionComponent->OnEndFocus.AddDynamic(this, &APickup::OnEndFocus);
 	InteractionComponent->SetupAttachment(PickupMesh);
 	
 	SetReplicates(true);
+
+	bFocused = false;
+	GroundTraceDistance = 500.f;
 }
 
 void APickup::InitializePickup(const TSubclassOf<class UItem> ItemClass, const int32 Quantity)
@@ -47,6 +55,7 @@ void APickup::OnRep_Item()
 {
 	if (Item) {
 		PickupMesh->SetStaticMesh(Item->PickupMesh);
+		RefreshInstance();
 		InteractionComponent->InteractableNameText = Item->ItemDisplayName;
 
 		//Clients bind to this delegate in order to refresh the interaction widget if item quantity changes
@@ -83,7 +92,114 @@ void APickup::BeginPlay()
 		//for KeyNeedstoReplicate
 		Item->MarkDirtyForReplication();
 	}
-	
+
+	if (HasAuthority()) {
+		if (UPickupDropSubsystem* DropSubsystem = GetWorld()->GetSubsystem<UPickupDropSubsystem>()) {
+			DropSubsystem->RegisterPickup(this);
+		}
+	}
+
+	//AlignWithGround and replicated movement move the mesh after the instance was placed
+	PickupMesh->TransformUpdated.AddUObject(this, &APickup::OnPickupMeshMoved);
+	RefreshInstance();
+}
+
+void APickup::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UPickupRenderSubsystem* RenderSubsystem = GetWorld()->GetSubsystem<UPickupRenderSubsystem>()) {
+		RenderSubsystem->RemoveInstance(InstanceHandle);
+	}
+	if (UPickupDropSubsystem* DropSubsystem = GetWorld()->GetSubsystem<UPickupDropSubsystem>()) {
+		DropSubsystem->UnregisterPickup(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void APickup::AlignWithGround_Implementation()
+{
+	//start a bit above so a pickup spawned slightly inside the ground still finds it
+	const FVector TraceStart = GetActorLocation() + FVector(0.f, 0.f, 50.f);
+	const FVector TraceEnd = TraceStart - FVector(0.f, 0.f, GroundTraceDistance);
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(PickupGroundTrace), false, this);
+
+	//death drops and loot explosions spawn lots of pickups in one frame, batch their traces instead of tracing each one right now
+	if (USceneQuerySubsystem* SceneQuery = GetWorld()->GetSubsystem<USceneQuerySubsystem>()) {
+		SceneQuery->QueueLineTrace(ESceneQueryCategory::Pickup, TraceStart, TraceEnd, ECC_Visibility, QueryParams, FOnSceneQueryComplete::CreateUObject(this, &APickup::OnGroundTraceCompleted));
+	}
+	else {
+		FHitResult GroundHit;
+		if (GetWorld()->LineTraceSingleByChannel(GroundHit, TraceStart, TraceEnd, ECC_Visibility, QueryParams)) {
+			SettleOnGround(GroundHit);
+		}
+	}
+}
+
+void APickup::OnGroundTraceCompleted(const FSceneQueryResult& Result)
+{
+	if (Result.bBlockingHit && !IsPendingKill()) {
+		SettleOnGround(Result.Hit);
+	}
+}
+
+void APickup::SettleOnGround(const FHitResult& GroundHit)
+{
+	//keep the yaw it was dropped with
+	const FRotator NewRotation = FRotationMatrix::MakeFromZX(GroundHit.ImpactNormal, GetActorForwardVector()).Rotator();
+
+	//pivot of pickup meshes isn't always at the bottom
+	float PivotHeight = 0.f;
+	if (PickupMesh->GetStaticMesh()) {
+		PivotHeight = -PickupMesh->GetStaticMesh()->GetBoundingBox().Min.Z * PickupMesh->GetComponentScale().Z;
+	}
+	const FVector NewLocation = GroundHit.ImpactPoint + GroundHit.ImpactNormal * PivotHeight;
+
+	SetActorLocationAndRotation(NewLocation, NewRotation, false, nullptr, ETeleportType::TeleportPhysics);
+
+	if (HasAuthority()) {
+		if (UPickupDropSubsystem* DropSubsystem = GetWorld()->GetSubsystem<UPickupDropSubsystem>()) {
+			DropSubsystem->UpdatePickupLocation(this);
+		}
+	}
+}
+
+void APickup::RefreshInstance()
+{
+	UPickupRenderSubsystem* RenderSubsystem = GetWorld() ? GetWorld()->GetSubsystem<UPickupRenderSubsystem>() : nullptr;
+	//item can replicate before BeginPlay, which refreshes again anyway
+	if (!RenderSubsystem || !(HasActorBegunPlay() || IsActorBeginningPlay())) {
+		return;
+	}
+
+	RenderSubsystem->RemoveInstance(InstanceHandle);
+	if (!bFocused && PickupMesh->GetStaticMesh()) {
+		InstanceHandle = RenderSubsystem->AddInstance(PickupMesh->GetStaticMesh(), PickupMesh->GetComponentTransform());
+	}
+
+	PickupMesh->SetVisibility(!InstanceHandle.IsValid());
+}
+
+void APickup::OnPickupMeshMoved(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	if (InstanceHandle.IsValid()) {
+		if (UPickupRenderSubsystem* RenderSubsystem = GetWorld()->GetSubsystem<UPickupRenderSubsystem>()) {
+			RenderSubsystem->UpdateInstance(InstanceHandle, PickupMesh->GetComponentTransform());
+		}
+	}
+}
+
+void APickup::OnBeginFocus(class ASurvivalCharacter* Character)
+{
+	//promote to the real mesh so the interaction outline has something to draw
+	bFocused = true;
+	RefreshInstance();
+}
+
+void APickup::OnEndFocus(class ASurvivalCharacter* Character)
+{
+	bFocused = false;
+	RefreshInstance();
 }
 
 void APickup::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
@@ -4,8 +4,11 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "World/PickupRenderSubsystem.h"
 #include "Pickup.generated.h"
 
+struct FSceneQueryResult;
+
 UCLASS()
 class SURVIVALGAME_API APickup : public AActor
 {
@@ -18,9 +21,11 @@ public:
 	//Takes the item to represent and creates the pickup from it. Done on BeginPlay and when a player drops an item on the ground.
 	void InitializePickup(const TSubclassOf<class UItem> ItemClass, const int32 Quantity);
 
-	/** Align pickups rotation with ground rotation */
-	//"BlueprintImplementableEvent" c++ ǰ blueprint implement
-	UFUNCTION(BlueprintImplementableEvent)
+	/**
+	 * Align pickups rotation with ground rotation.
+	 * Native version queues a ground trace with the scene query batch, and the pickup settles on the ground when the result comes back
+	 */
+	UFUNCTION(BlueprintNativeEvent)
 	void AlignWithGround();
 
 	// This is used as a template to create the pickup when spawned in
@@ -28,6 +33,8 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Instanced)
 	class UItem* ItemTemplate;
 
+	FORCEINLINE class UItem* GetItem() const { return Item; }
+
 protected:
 
 	/** The item that will be added to the inventory when this pickup is taken */
@@ -43,6 +50,7 @@ protected:
 
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	//will have replicated item
 	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
@@ -60,5 +68,31 @@ protected:
 	UPROPERTY(EditDefaultsOnly, Category="Components")
 	class UInteractionComponent* InteractionComponent;
 
+	/** how far below the pickup AlignWithGround looks for ground */
+	UPROPERTY(EditDefaultsOnly, Category="Pickup")
+	float GroundTraceDistance;
+
+	void OnGroundTraceCompleted(const FSceneQueryResult& Result);
+
+	/** Put the bottom of the mesh on the hit, tilted to the ground normal. Just a teleport, pickups don't simulate physics */
+	void SettleOnGround(const FHitResult& GroundHit);
+
+	/** instance drawing this pickup while nobody focuses it. PickupMesh stays hidden (but still collides) while this is valid */
+	FPickupInstanceHandle InstanceHandle;
+
+	/** true while the local player focuses the pickup, so it's drawn by its own mesh and can be outlined */
+	bool bFocused;
+
+	/** Draw the pickup through UPickupRenderSubsystem, or by PickupMesh if focused or there's no subsystem */
+	void RefreshInstance();
+
+	void OnPickupMeshMoved(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+
+	UFUNCTION()
+	void OnBeginFocus(class ASurvivalCharacter* Character);
+
+	UFUNCTION()
+	void OnEndFocus(class ASurvivalCharacter* Character);
+
 
 };
@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "World/PickupDropSubsystem.h"
+#include "World/Pickup.h"
+#include "Items/Item.h"
+#include "Engine/World.h"
+
+static FAutoConsoleCommandWithWorld PickupDropStatsCommand(
+	TEXT("Survival.PickupDropStats"),
+	TEXT("Print how many pickups the server tracks for drop merging"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (UPickupDropSubsystem* DropSubsystem = World ? World->GetSubsystem<UPickupDropSubsystem>() : nullptr) {
+			UE_LOG(LogTemp, Log, TEXT("Pickups on the ground: %d"), DropSubsystem->GetNumPickups());
+		}
+	}));
+
+UPickupDropSubsystem::UPickupDropSubsystem()
+{
+	MergeRadius = 200.f;
+	GridCellSize = 1000.f;
+	MaxPickupsPerCell = 64;
+}
+
+bool UPickupDropSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	if (!Super::ShouldCreateSubsystem(Outer)) {
+		return false;
+	}
+
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UPickupDropSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	//config is only loaded after the constructor
+	PickupGrid = TSpatialHashGrid<APickup*>(GridCellSize);
+}
+
+void UPickupDropSubsystem::RegisterPickup(APickup* Pickup)
+{
+	if (Pickup && !PickupLocations.Contains(Pickup)) {
+		const FVector Location = Pickup->GetActorLocation();
+		PickupGrid.Add(Pickup, Location);
+		PickupLocations.Add(Pickup, Location);
+	}
+}
+
+void UPickupDropSubsystem::UnregisterPickup(APickup* Pickup)
+{
+	FVector Location;
+	if (PickupLocations.RemoveAndCopyValue(Pickup, Location)) {
+		PickupGrid.Remove(Pickup, Location);
+	}
+}
+
+void UPickupDropSubsystem::UpdatePickupLocation(APickup* Pickup)
+{
+	if (FVector* Location = PickupLocations.Find(Pickup)) {
+		const FVector NewLocation = Pickup->GetActorLocation();
+		PickupGrid.Move(Pickup, *Location, NewLocation);
+		*Location = NewLocation;
+	}
+}
+
+int32 UPickupDropSubsystem::GetMergeSpace(const TSubclassOf<UItem> ItemClass, const FVector& Location, const int32 Quantity) const
+{
+	TArray<APickup*> Targets;
+	GetMergeTargets(ItemClass, Location, Targets);
+
+	int32 Space = 0;
+	for (APickup* Target : Targets) {
+		const UItem* TargetItem = Target->GetItem();
+		Space += TargetItem->MaxStackSize - TargetItem->GetQuantity();
+		if (Space >= Quantity) {
+			return Quantity;
+		}
+	}
+	return Space;
+}
+
+int32 UPickupDropSubsystem::MergeIntoNearbyPickups(const TSubclassOf<UItem> ItemClass, const FVector& Location, const int32 Quantity)
+{
+	TArray<APickup*> Targets;
+	GetMergeTargets(ItemClass, Location, Targets);
+
+	int32 Merged = 0;
+	for (APickup* Target : Targets) {
+		if (Merged >= Quantity) {
+			break;
+		}
+
+		UItem* TargetItem = Target->GetItem();
+		const int32 AmountToMerge = FMath::Min(TargetItem->MaxStackSize - TargetItem->GetQuantity(), Quantity - Merged);
+		TargetItem->SetQuantity(TargetItem->GetQuantity() + AmountToMerge);
+		Merged += AmountToMerge;
+	}
+	return Merged;
+}
+
+bool UPickupDropSubsystem::CanSpawnPickupAt(const FVector& Location) const
+{
+	return PickupGrid.NumInCell(Location) < MaxPickupsPerCell;
+}
+
+void UPickupDropSubsystem::GetMergeTargets(const TSubclassOf<UItem> ItemClass, const FVector& Location, TArray<APickup*>& OutPickups) const
+{
+	if (!ItemClass || !ItemClass->GetDefaultObject<UItem>()->bStackable) {
+		return;
+	}
+
+	PickupGrid.ForEachInRadius(Location, MergeRadius, [&](APickup* Pickup, const FVector&) {
+		const UItem* PickupItem = IsValid(Pickup) ? Pickup->GetItem() : nullptr;
+		if (PickupItem && PickupItem->GetClass() == ItemClass && PickupItem->GetQuantity() < PickupItem->MaxStackSize) {
+			OutPickups.Add(Pickup);
+		}
+	});
+
+	OutPickups.Sort([&Location](const APickup& A, const APickup& B) {
+		return FVector::DistSquared(A.GetActorLocation(), Location) < FVector::DistSquared(B.GetActorLocation(), Location);
+	});
+}
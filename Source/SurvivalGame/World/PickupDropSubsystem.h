@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "World/SpatialGrid.h"
+#include "PickupDropSubsystem.generated.h"
+
+class APickup;
+class UItem;
+
+/**
+ * Server side spatial lookup of every pickup in the world. Drops of stackable items are merged into pickups of the same class
+ * already lying nearby, and every grid cell has a cap on pickup actors so spam dropping can't pile up unbounded actors in one spot.
+ */
+UCLASS(Config = Game)
+class SURVIVALGAME_API UPickupDropSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UPickupDropSubsystem();
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	void RegisterPickup(APickup* Pickup);
+	void UnregisterPickup(APickup* Pickup);
+
+	/** Move a registered pickup to its current location, ie after it settled on the ground */
+	void UpdatePickupLocation(APickup* Pickup);
+
+	/** Get how much of the quantity nearby pickups of the class have room for */
+	int32 GetMergeSpace(const TSubclassOf<UItem> ItemClass, const FVector& Location, const int32 Quantity) const;
+
+	/** Add as much of the quantity as fits to nearby pickups of the class, closest first. Return how much was merged */
+	int32 MergeIntoNearbyPickups(const TSubclassOf<UItem> ItemClass, const FVector& Location, const int32 Quantity);
+
+	/** Check if the cell of the location has room for another pickup actor */
+	bool CanSpawnPickupAt(const FVector& Location) const;
+
+	FORCEINLINE int32 GetNumPickups() const { return PickupGrid.Num(); }
+
+protected:
+	/** drops merge into pickups within this distance */
+	UPROPERTY(Config)
+	float MergeRadius;
+
+	UPROPERTY(Config)
+	float GridCellSize;
+
+	/** max pickup actors a grid cell may hold before drops there are refused */
+	UPROPERTY(Config)
+	int32 MaxPickupsPerCell;
+
+	TSpatialHashGrid<APickup*> PickupGrid;
+
+	/** where each pickup was added to the grid, needed to remove it again */
+	TMap<APickup*, FVector> PickupLocations;
+
+	/** Get stackable pickups of the class with room left near the location, closest first */
+	void GetMergeTargets(const TSubclassOf<UItem> ItemClass, const FVector& Location, TArray<APickup*>& OutPickups) const;
+};
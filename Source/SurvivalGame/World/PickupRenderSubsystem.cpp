@@ -0,0 +1,112 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "World/PickupRenderSubsystem.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+
+static FAutoConsoleCommandWithWorld PickupRenderStatsCommand(
+	TEXT("Survival.PickupRenderStats"),
+	TEXT("Print how many pickups are drawn as instances and by how many components"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (UPickupRenderSubsystem* RenderSubsystem = World ? World->GetSubsystem<UPickupRenderSubsystem>() : nullptr) {
+			int32 NumInstances, NumFreeInstances, NumComponents;
+			RenderSubsystem->GetStats(NumInstances, NumFreeInstances, NumComponents);
+			UE_LOG(LogTemp, Log, TEXT("Pickup instances: %d drawn, %d free, %d components"), NumInstances - NumFreeInstances, NumFreeInstances, NumComponents);
+		}
+	}));
+
+bool UPickupRenderSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	if (!Super::ShouldCreateSubsystem(Outer)) {
+		return false;
+	}
+
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld() && !IsRunningDedicatedServer();
+}
+
+FPickupInstanceHandle UPickupRenderSubsystem::AddInstance(UStaticMesh* Mesh, const FTransform& Transform)
+{
+	FPickupInstanceHandle Handle;
+	if (!Mesh) {
+		return Handle;
+	}
+
+	Handle.BatchIndex = GetOrCreateBatch(Mesh);
+	if (Handle.BatchIndex == INDEX_NONE) {
+		return Handle;
+	}
+
+	UHierarchicalInstancedStaticMeshComponent* InstanceComponent = InstanceComponents[Handle.BatchIndex];
+	TArray<int32>& BatchFreeInstances = FreeInstances[Handle.BatchIndex];
+	if (BatchFreeInstances.Num() > 0) {
+		Handle.InstanceIndex = BatchFreeInstances.Pop(false);
+		InstanceComponent->UpdateInstanceTransform(Handle.InstanceIndex, Transform, true, true, true);
+	}
+	else {
+		Handle.InstanceIndex = InstanceComponent->AddInstanceWorldSpace(Transform);
+	}
+	return Handle;
+}
+
+void UPickupRenderSubsystem::UpdateInstance(const FPickupInstanceHandle& Handle, const FTransform& Transform)
+{
+	if (Handle.IsValid() && InstanceComponents.IsValidIndex(Handle.BatchIndex)) {
+		InstanceComponents[Handle.BatchIndex]->UpdateInstanceTransform(Handle.InstanceIndex, Transform, true, true, true);
+	}
+}
+
+void UPickupRenderSubsystem::RemoveInstance(FPickupInstanceHandle& Handle)
+{
+	if (Handle.IsValid() && InstanceComponents.IsValidIndex(Handle.BatchIndex)) {
+		//removing would move the last instance into this index and break its handle, so hide it and keep the slot for reuse
+		FTransform HiddenTransform = FTransform::Identity;
+		HiddenTransform.SetScale3D(FVector::ZeroVector);
+		InstanceComponents[Handle.BatchIndex]->UpdateInstanceTransform(Handle.InstanceIndex, HiddenTransform, true, true, true);
+		FreeInstances[Handle.BatchIndex].Add(Handle.InstanceIndex);
+	}
+	Handle.Reset();
+}
+
+void UPickupRenderSubsystem::GetStats(int32& OutNumInstances, int32& OutNumFreeInstances, int32& OutNumComponents) const
+{
+	OutNumInstances = 0;
+	OutNumFreeInstances = 0;
+	OutNumComponents = InstanceComponents.Num();
+	for (int32 i = 0; i < InstanceComponents.Num(); ++i) {
+		OutNumInstances += InstanceComponents[i] ? InstanceComponents[i]->GetInstanceCount() : 0;
+		OutNumFreeInstances += FreeInstances[i].Num();
+	}
+}
+
+int32 UPickupRenderSubsystem::GetOrCreateBatch(UStaticMesh* Mesh)
+{
+	if (const int32* BatchIndex = BatchIndices.Find(Mesh)) {
+		return *BatchIndex;
+	}
+
+	if (!InstanceOwner) {
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.ObjectFlags |= RF_Transient;
+		InstanceOwner = GetWorld()->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+		if (!InstanceOwner) {
+			return INDEX_NONE;
+		}
+		InstanceOwner->SetRootComponent(NewObject<USceneComponent>(InstanceOwner, TEXT("Root")));
+		InstanceOwner->GetRootComponent()->RegisterComponent();
+	}
+
+	UHierarchicalInstancedStaticMeshComponent* InstanceComponent = NewObject<UHierarchicalInstancedStaticMeshComponent>(InstanceOwner);
+	InstanceComponent->SetStaticMesh(Mesh);
+	//pickups keep their own hidden mesh for interaction traces
+	InstanceComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	InstanceComponent->SetupAttachment(InstanceOwner->GetRootComponent());
+	InstanceComponent->RegisterComponent();
+
+	const int32 BatchIndex = InstanceComponents.Add(InstanceComponent);
+	FreeInstances.AddDefaulted();
+	BatchIndices.Add(Mesh, BatchIndex);
+	return BatchIndex;
+}
@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PickupRenderSubsystem.generated.h"
+
+class UStaticMesh;
+class UHierarchicalInstancedStaticMeshComponent;
+
+/** Refers to one instance drawn by UPickupRenderSubsystem. Stays valid until the instance is removed */
+struct FPickupInstanceHandle {
+	int32 BatchIndex = INDEX_NONE;
+	int32 InstanceIndex = INDEX_NONE;
+
+	bool IsValid() const { return BatchIndex != INDEX_NONE && InstanceIndex != INDEX_NONE; }
+	void Reset() { BatchIndex = InstanceIndex = INDEX_NONE; }
+};
+
+/**
+ * Draws idle pickups as instances of one hierarchical instanced static mesh component per pickup mesh, instead of a static mesh component each.
+ * Removed instances are scaled to zero and reused by the next pickup of the mesh, so instance indices never shift and handles stay stable.
+ * Pickups keep their own (hidden) mesh for collision, and show it again while focused so outlines work.
+ * Only created on machines that render (never on dedicated servers).
+ */
+UCLASS()
+class SURVIVALGAME_API UPickupRenderSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	/** Start drawing an instance of the mesh */
+	FPickupInstanceHandle AddInstance(UStaticMesh* Mesh, const FTransform& Transform);
+
+	void UpdateInstance(const FPickupInstanceHandle& Handle, const FTransform& Transform);
+
+	/** Stop drawing the instance and reset the handle */
+	void RemoveInstance(FPickupInstanceHandle& Handle);
+
+	/** Get how many instances are drawn and how many components draw them */
+	void GetStats(int32& OutNumInstances, int32& OutNumFreeInstances, int32& OutNumComponents) const;
+
+protected:
+	/** owns the instanced components */
+	UPROPERTY(Transient)
+	AActor* InstanceOwner;
+
+	/** instanced component of every mesh, indexed by batch index */
+	UPROPERTY(Transient)
+	TArray<UHierarchicalInstancedStaticMeshComponent*> InstanceComponents;
+
+	/** instances scaled to zero waiting for reuse, per batch */
+	TArray<TArray<int32>> FreeInstances;
+
+	TMap<TObjectKey<UStaticMesh>, int32> BatchIndices;
+
+	/** Get the batch of the mesh, creating its component if needed */
+	int32 GetOrCreateBatch(UStaticMesh* Mesh);
+};
@@ -0,0 +1,120 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Uniform grid over the XY plane, hashing elements into square cells so radius queries only look at nearby cells.
+ * Meant for lots of things that rarely move (spawn points, pickups) queried around a few things that do (players).
+ */
+template<typename ElementType>
+class TSpatialHashGrid
+{
+public:
+	explicit TSpatialHashGrid(const float InCellSize = 5000.f)
+		: CellSize(FMath::Max(InCellSize, 1.f))
+	{
+	}
+
+	void Add(const ElementType& Element, const FVector& Location)
+	{
+		Cells.FindOrAdd(GetCell(Location)).Add({ Element, Location });
+		++NumElements;
+	}
+
+	/** Remove the element. Location has to be the one it was added with */
+	bool Remove(const ElementType& Element, const FVector& Location)
+	{
+		const FIntPoint Cell = GetCell(Location);
+		if (TArray<FEntry>* Entries = Cells.Find(Cell)) {
+			const int32 Index = Entries->IndexOfByPredicate([&Element](const FEntry& Entry) { return Entry.Element == Element; });
+			if (Index != INDEX_NONE) {
+				Entries->RemoveAtSwap(Index, 1, false);
+				if (Entries->Num() == 0) {
+					Cells.Remove(Cell);
+				}
+				--NumElements;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void Move(const ElementType& Element, const FVector& OldLocation, const FVector& NewLocation)
+	{
+		if (GetCell(OldLocation) != GetCell(NewLocation)) {
+			if (Remove(Element, OldLocation)) {
+				Add(Element, NewLocation);
+			}
+		}
+		else if (TArray<FEntry>* Entries = Cells.Find(GetCell(OldLocation))) {
+			if (FEntry* Entry = Entries->FindByPredicate([&Element](const FEntry& Entry) { return Entry.Element == Element; })) {
+				Entry->Location = NewLocation;
+			}
+		}
+	}
+
+	/** Call Func(Element, Location) for every element within the radius of the location, ignoring height */
+	template<typename FuncType>
+	void ForEachInRadius(const FVector& Location, const float Radius, FuncType Func) const
+	{
+		const FIntPoint MinCell = GetCell(Location - FVector(Radius, Radius, 0.f));
+		const FIntPoint MaxCell = GetCell(Location + FVector(Radius, Radius, 0.f));
+		const float RadiusSquared = FMath::Square(Radius);
+
+		for (int32 X = MinCell.X; X <= MaxCell.X; ++X) {
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y) {
+				if (const TArray<FEntry>* Entries = Cells.Find(FIntPoint(X, Y))) {
+					for (const FEntry& Entry : *Entries) {
+						if (FVector::DistSquared2D(Entry.Location, Location) <= RadiusSquared) {
+							Func(Entry.Element, Entry.Location);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	/** Check if any element lies within the radius of the location, ignoring height */
+	bool AnyInRadius(const FVector& Location, const float Radius) const
+	{
+		bool bFound = false;
+		ForEachInRadius(Location, Radius, [&bFound](const ElementType&, const FVector&) { bFound = true; });
+		return bFound;
+	}
+
+	/** Get how many elements share the cell of the location */
+	int32 NumInCell(const FVector& Location) const
+	{
+		const TArray<FEntry>* Entries = Cells.Find(GetCell(Location));
+		return Entries ? Entries->Num() : 0;
+	}
+
+	void Reset()
+	{
+		Cells.Reset();
+		NumElements = 0;
+	}
+
+	int32 Num() const { return NumElements; }
+
+	float GetCellSize() const { return CellSize; }
+
+	FIntPoint GetCell(const FVector& Location) const
+	{
+		return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+	}
+
+private:
+	struct FEntry {
+		ElementType Element;
+		FVector Location;
+	};
+
+	TMap<FIntPoint, TArray<FEntry>> Cells;
+
+	float CellSize;
+
+	int32 NumElements = 0;
+};
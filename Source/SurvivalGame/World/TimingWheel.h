@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Hierarchical timing wheel. Scheduling and expiring are O(1) no matter how many elements are waiting, unlike a timer per element.
+ * Level 0 has a slot per tick, every higher level has a slot per full rotation of the level below. Elements far in the future wait in a
+ * coarse slot and are moved down a level each time their slot comes up, until they expire from level 0 on their exact tick.
+ * Delays longer than the whole wheel wait in the last slot of the top level and get rescheduled when it comes up.
+ */
+template<typename ElementType, int32 SlotsPerLevel = 64, int32 NumLevels = 3>
+class THierarchicalTimingWheel
+{
+public:
+	explicit THierarchicalTimingWheel(const float InTickInterval = 0.1f)
+		: TickInterval(FMath::Max(InTickInterval, KINDA_SMALL_NUMBER))
+	{
+		for (int32 Level = 0; Level < NumLevels; ++Level) {
+			Levels[Level].SetNum(SlotsPerLevel);
+		}
+	}
+
+	/** Schedule the element to expire after the delay. Rounded up to whole ticks, and at least one tick */
+	void Schedule(const ElementType& Element, const float Delay)
+	{
+		const int64 DueTick = CurrentTick + FMath::Max<int64>(FMath::CeilToInt(Delay / TickInterval), 1);
+		Insert({ Element, DueTick });
+		++NumElements;
+	}
+
+	/** Advance time, adding every element that expired to OutExpired in the order they expired */
+	void Advance(const float DeltaTime, TArray<ElementType>& OutExpired)
+	{
+		Accumulator += DeltaTime;
+		while (Accumulator >= TickInterval) {
+			Accumulator -= TickInterval;
+			++CurrentTick;
+
+			//top down, so elements moved down land in lower slots before those come up this tick
+			for (int32 Level = NumLevels - 1; Level > 0; --Level) {
+				const int64 Span = GetSpan(Level);
+				if (CurrentTick % Span == 0) {
+					TArray<FEntry> Entries = MoveTemp(Levels[Level][(CurrentTick / Span) % SlotsPerLevel]);
+					for (const FEntry& Entry : Entries) {
+						if (Entry.DueTick <= CurrentTick) {
+							OutExpired.Add(Entry.Element);
+							--NumElements;
+						}
+						else {
+							Insert(Entry);
+						}
+					}
+				}
+			}
+
+			TArray<FEntry>& Slot = Levels[0][CurrentTick % SlotsPerLevel];
+			for (const FEntry& Entry : Slot) {
+				OutExpired.Add(Entry.Element);
+			}
+			NumElements -= Slot.Num();
+			Slot.Reset();
+		}
+	}
+
+	/** Get how many elements are waiting */
+	int32 Num() const { return NumElements; }
+
+	float GetTickInterval() const { return TickInterval; }
+
+private:
+	struct FEntry {
+		ElementType Element;
+		int64 DueTick;
+	};
+
+	static int64 GetSpan(const int32 Level)
+	{
+		int64 Span = 1;
+		for (int32 i = 0; i < Level; ++i) {
+			Span *= SlotsPerLevel;
+		}
+		return Span;
+	}
+
+	void Insert(const FEntry& Entry)
+	{
+		//lowest level where the due tick falls within the coming rotation
+		for (int32 Level = 0; Level < NumLevels; ++Level) {
+			const int64 Span = GetSpan(Level);
+			if (Entry.DueTick / Span - CurrentTick / Span < SlotsPerLevel) {
+				Levels[Level][(Entry.DueTick / Span) % SlotsPerLevel].Add(Entry);
+				return;
+			}
+		}
+
+		const int64 TopSpan = GetSpan(NumLevels - 1);
+		Levels[NumLevels - 1][(CurrentTick / TopSpan + SlotsPerLevel - 1) % SlotsPerLevel].Add(Entry);
+	}
+
+	TArray<TArray<FEntry>> Levels[NumLevels];
+
+	float TickInterval;
+
+	float Accumulator = 0.f;
+
+	int64 CurrentTick = 0;
+
+	int32 NumElements = 0;
+};